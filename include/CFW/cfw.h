@@ -16,6 +16,9 @@
 #pragma once
 #endif
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -91,6 +94,35 @@ extern "C" {
 #define CFW_BOLD_YELLOW     14
 #define CFW_BOLD_WHITE      15
 
+/**
+ * @brief Make a 24-bit color.
+ * 
+ * Combines the red, green and blue components, each from 0 to 255,
+ * into a color for `cfw_set_color_rgb()`.
+ */
+#define CFW_RGB(r, g, b)    ((((r) & 0xFF) << 16) | (((g) & 0xFF) << 8) | ((b) & 0xFF))
+
+/**
+ * @brief Color that keeps the current draw color.
+ * 
+ * Runs passed to `cfw_draw_attr_str()` with this color are drawn
+ * with the color set by the color functions.
+ */
+#define CFW_CURRENT_COLOR   -1
+
+/* Text attributes */
+#define CFW_ATTR_BOLD       0x01
+#define CFW_ATTR_UNDERLINE  0x02
+#define CFW_ATTR_REVERSE    0x04
+
+/**
+ * @brief 24-bit color run attribute.
+ * 
+ * The colors of a run with this attribute are 24-bit colors made
+ * with `CFW_RGB()`, instead of the CFW colors.
+ */
+#define CFW_ATTR_RGB        0x100
+
 /* Function keys */
 #define CFW_KEY_UP          0400
 #define CFW_KEY_DOWN        0401
@@ -162,6 +194,13 @@ extern "C" {
  */
 #define CFW_NOT_ENABLED     0x00010003
 
+/**
+ * @brief CFW out of memory.
+ * 
+ * This error is for when CFW fails to allocate memory.
+ */
+#define CFW_OUT_OF_MEMORY   0x00010004
+
 /**
  * @brief Color support.
  * 
@@ -200,6 +239,91 @@ extern "C" {
  */
 #define CFW_FILL    0x00030003
 
+/**
+ * @brief Even-odd fill rule.
+ * 
+ * A cell is inside a polygon when a ray from it crosses the edges of
+ * the polygon an odd number of times.
+ */
+#define CFW_EVEN_ODD    0x00040001
+
+/**
+ * @brief Nonzero fill rule.
+ * 
+ * A cell is inside a polygon when the edges of the polygon wind
+ * around it, counting edges going down and up opposite ways.
+ */
+#define CFW_NONZERO     0x00040002
+
+/**
+ * @brief Cells canvas mode.
+ * 
+ * Geometry is drawn with one character per cell.
+ */
+#define CFW_CELLS       0x00050001
+
+/**
+ * @brief Braille canvas mode.
+ * 
+ * Geometry is drawn in braille dots, 2 across and 4 down per cell.
+ */
+#define CFW_BRAILLE     0x00050002
+
+/**
+ * @brief Half-block canvas mode.
+ * 
+ * Geometry is drawn in half blocks, 1 across and 2 down per cell.
+ */
+#define CFW_HALF_BLOCKS 0x00050003
+
+/**
+ * @brief No dithering.
+ * 
+ * Pixels are drawn with the closest color of the console.
+ */
+#define CFW_DITHER_NONE             0x00060001
+
+/**
+ * @brief Ordered dithering.
+ * 
+ * Pixels are offset by a 4x4 Bayer matrix before the closest color
+ * of the console is found. Unchanged images give the same cells every
+ * frame.
+ */
+#define CFW_DITHER_ORDERED          0x00060002
+
+/**
+ * @brief Floyd-Steinberg dithering.
+ * 
+ * What the color of a pixel is off by is spread over the pixels to
+ * the right and below it.
+ */
+#define CFW_DITHER_FLOYD_STEINBERG  0x00060003
+
+/**
+ * @brief Thousands separator number format flag.
+ * 
+ * The digits before the decimal point are grouped in threes,
+ * separated by commas.
+ */
+#define CFW_FORMAT_THOUSANDS  0x01
+
+/**
+ * @brief Zero padding number format flag.
+ * 
+ * Numbers are padded to their width with zeros after the sign,
+ * instead of spaces before it.
+ */
+#define CFW_FORMAT_ZERO_PAD   0x02
+
+/**
+ * @brief Left alignment number format flag.
+ * 
+ * Numbers are padded to their width with spaces after them, instead
+ * of before them. Takes precedence over `CFW_FORMAT_ZERO_PAD`.
+ */
+#define CFW_FORMAT_LEFT_ALIGN 0x04
+
 /**
  * @brief A boolean value.
  * 
@@ -227,6 +351,35 @@ typedef void (* cfw__errorfun)(int,const char *);
  */
 typedef void (* cfw__charfun)(int);
 
+/**
+ * @brief A view of a string.
+ * 
+ * This is a string that doesn't have to be NUL-terminated, like
+ * part of a larger buffer. CFW never copies or modifies the data.
+ */
+typedef struct cfw__strview
+{
+    const char *data;
+    size_t length;
+} cfw__strview;
+
+/**
+ * @brief A run of text drawn with the same attributes.
+ * 
+ * This is used by `cfw_draw_attr_str()` to draw the next `length`
+ * bytes of its text with the given colors and attributes. The colors
+ * are CFW colors, 24-bit colors when `attrs` has `CFW_ATTR_RGB`, or
+ * `CFW_CURRENT_COLOR`. The attributes are a combination of the
+ * `CFW_ATTR_*` flags.
+ */
+typedef struct cfw__attr_run
+{
+    size_t length;
+    int fg;
+    int bg;
+    int attrs;
+} cfw__attr_run;
+
 /**
  * @brief Initialize CFW.
  * 
@@ -306,6 +459,11 @@ CFWAPI void *cfw_get_user_pointer(void);
  * @brief Refresh the console.
  * 
  * This function refreshes the content of the console.
+ * 
+ * Draw calls are not sent to the console directly. CFW keeps its
+ * own buffer of the console content, and only the characters that
+ * changed since the last refresh are sent to the console. If
+ * nothing changed, the console is left untouched.
  */
 CFWAPI void cfw_refresh(void);
 
@@ -408,6 +566,20 @@ CFWAPI int cfw_get_pressed_char(void);
  */
 CFWAPI void cfw_clear(void);
 
+/**
+ * @brief Clear a rectangle of the console.
+ * 
+ * This function clears the content inside the given rectangle, in
+ * the same way `cfw_clear()` clears the entire console. Only the
+ * part of the rectangle inside the current region is cleared.
+ * 
+ * @param x The X position of the top left corner of the rectangle.
+ * @param y The Y position of the top left corner of the rectangle.
+ * @param width The width of the rectangle.
+ * @param height The height of the rectangle.
+ */
+CFWAPI void cfw_clear_rect(int x, int y, int width, int height);
+
 /**
  * @brief Set the way polygons are rasterized.
  * 
@@ -420,6 +592,54 @@ CFWAPI void cfw_clear(void);
  */
 CFWAPI void cfw_polygon_mode(int mode);
 
+/**
+ * @brief Set the way self-intersecting polygons are filled.
+ * 
+ * This function specifies which cells are inside the polygons
+ * filled by `cfw_draw_polygon`, and by `cfw_draw_quad` for quads
+ * that aren't convex. The rules only differ for polygons crossing
+ * themselves or overlapping themselves.
+ * 
+ * Can be `CFW_NONZERO`, the default, or `CFW_EVEN_ODD`.
+ * 
+ * @param rule Specifies which cells are inside polygons.
+ */
+CFWAPI void cfw_fill_rule(int rule);
+
+/**
+ * @brief Set the resolution geometry is drawn in.
+ * 
+ * This function specifies if lines, polylines, points, triangles,
+ * quads, polygons, circles and ellipses are drawn to cells, or to a
+ * canvas of dots finer than the cells. In `CFW_BRAILLE` and
+ * `CFW_HALF_BLOCKS` mode, the positions and sizes given to those draw
+ * calls are in dots, and their character is ignored. When the
+ * console is refreshed, every cell with new dots shows all the dots
+ * drawn to it since the last `cfw_clear`, in the colors set when its
+ * last dot was drawn.
+ * 
+ * Can be `CFW_CELLS`, the default, `CFW_BRAILLE` or
+ * `CFW_HALF_BLOCKS`. The dots drawn before the mode changes stay in
+ * their cells.
+ * 
+ * @param mode Specifies the resolution geometry is drawn in.
+ */
+CFWAPI void cfw_canvas_mode(int mode);
+
+/**
+ * @brief Set the way images are dithered.
+ * 
+ * This function specifies how the pixels drawn by `cfw_blit_rgb` are
+ * turned into colors on consoles with 256 or 16 colors. Consoles with
+ * 24-bit colors draw the pixels as they are.
+ * 
+ * Can be `CFW_DITHER_ORDERED`, the default, `CFW_DITHER_NONE` or
+ * `CFW_DITHER_FLOYD_STEINBERG`.
+ * 
+ * @param mode Specifies how images are dithered.
+ */
+CFWAPI void cfw_dither_mode(int mode);
+
 /**
  * @brief Set draw colors to default.
  * 
@@ -445,6 +665,25 @@ CFWAPI void cfw_set_default_color(void);
  */
 CFWAPI void cfw_set_color(int foreground_color, int background_color);
 
+/**
+ * @brief Set the draw colors to 24-bit colors.
+ * 
+ * This function sets both the foreground color and the background
+ * color of the draw to any 24-bit color, made with `CFW_RGB()`.
+ * 
+ * Consoles that support 24-bit colors display the colors as they
+ * are. Other consoles display the closest color they have, from the
+ * 256 color palette or the 16 basic colors.
+ * 
+ * To use this function, `CFW_COLORS` has to be enabled. Enable it
+ * with `cfw_enable()` passing in the color feature. To check if your
+ * system supports colors, call `cfw_is_feature_supported()`.
+ * 
+ * @param foreground_color The color to set the foreground to.
+ * @param background_color The color to set the background to.
+ */
+CFWAPI void cfw_set_color_rgb(int foreground_color, int background_color);
+
 /**
  * @brief Set the draw foreground color.
  * 
@@ -475,7 +714,11 @@ CFWAPI void cfw_set_background_color(int color);
  * 
  * This function begins drawing inside a region. If a region is
  * already begun, the new region will be constrained to the previous
- * region.
+ * region. Everything drawn outside of the region is discarded.
+ * 
+ * Regions can be nested up to 64 levels deep. Regions begun beyond
+ * that raise a `CFW_INVALID_VALUE` error and are ignored, but must
+ * still be ended.
  * 
  * @param x The X position of where to start the region.
  * @param y The Y position of where to start the region.
@@ -510,7 +753,8 @@ CFWAPI void cfw_get_region_bounds(int *width, int *height);
  * @brief Draw a character to the console.
  * 
  * This function draws the provided character to the console at the
- * given position.
+ * given position. Only printable ASCII characters can be drawn this
+ * way, anything else is drawn as the replacement character.
  * 
  * @param x The X position to draw the char at.
  * @param y The Y position to draw the char at.
@@ -524,19 +768,83 @@ CFWAPI void cfw_draw_char(int x, int y, char c);
  * This function draws the provided string to the console at the
  * given position.
  * 
+ * The string is UTF-8 encoded. Wide characters, like most CJK
+ * characters and emoji, take up two columns, while combining marks
+ * and control characters are left out. Invalid UTF-8 is drawn as
+ * the replacement character.
+ * 
  * @param x The X position to start drawing the string to.
  * @param y The Y position to start drawing the string to.
  * @param str The string to draw at the given position.
  */
 CFWAPI void cfw_draw_str(int x, int y, const char *str);
 
+/**
+ * @brief Draw a string of a given length to the console.
+ * 
+ * This function draws the first `length` bytes of the provided
+ * string to the console at the given position, like
+ * `cfw_draw_str`. The string doesn't have to be NUL-terminated.
+ * 
+ * @param x The X position to start drawing the string to.
+ * @param y The Y position to start drawing the string to.
+ * @param str The string to draw at the given position.
+ * @param length The length of the string in bytes.
+ */
+CFWAPI void cfw_draw_strn(int x, int y, const char *str, size_t length);
+
+/**
+ * @brief Draw a string view to the console.
+ * 
+ * This function draws the string the view refers to at the given
+ * position, like `cfw_draw_strn`.
+ * 
+ * @param x The X position to start drawing the string to.
+ * @param y The Y position to start drawing the string to.
+ * @param str The view of the string to draw at the given position.
+ */
+CFWAPI void cfw_draw_strview(int x, int y, cfw__strview str);
+
+/**
+ * @brief Draw a string with attributed runs to the console.
+ * 
+ * This function draws the provided string to the console at the
+ * given position, like `cfw_draw_strn`, with each run of the text
+ * drawn with the colors and attributes of the run. The runs follow
+ * each other through the text, which is as long as all the runs
+ * together. The current draw colors are left unchanged.
+ * 
+ * To draw runs with colors other than `CFW_CURRENT_COLOR`,
+ * `CFW_COLORS` has to be enabled. Enable it with `cfw_enable()`
+ * passing in the color feature.
+ * 
+ * @code
+ * const char *line = "int x = 42;";
+ * cfw__attr_run runs[] =
+ * {
+ *     { 3, CFW_BOLD_BLUE, CFW_CURRENT_COLOR, 0 },
+ *     { 5, CFW_CURRENT_COLOR, CFW_CURRENT_COLOR, 0 },
+ *     { 2, CFW_MAGENTA, CFW_CURRENT_COLOR, CFW_ATTR_UNDERLINE },
+ *     { 1, CFW_CURRENT_COLOR, CFW_CURRENT_COLOR, 0 },
+ * };
+ * cfw_draw_attr_str(0, 0, line, runs, 4);
+ * @endcode
+ * 
+ * @param x The X position to start drawing the string to.
+ * @param y The Y position to start drawing the string to.
+ * @param text The string to draw at the given position.
+ * @param runs The runs to draw the string with.
+ * @param run_count The number of runs.
+ */
+CFWAPI void cfw_draw_attr_str(int x, int y, const char *text,
+                              const cfw__attr_run *runs, size_t run_count);
+
 /**
  * @brief Draw a formatted string to the console.
  * 
  * This function takes in a string, formats it, and draws it to the
- * console at the given position.
- * 
- * The final string can maximum be 1024 chars long.
+ * console at the given position. The formatted string can be of any
+ * length.
  * 
  * @param x The X position to start drawing the string to.
  * @param y The Y position to start drawing the string to.
@@ -563,11 +871,27 @@ CFWAPI void cfw_draw_fmt_str(int x, int y, const char *fmt, ...);
  */
 CFWAPI void cfw_draw_int(int x, int y, int i);
 
+/**
+ * @brief Draw an unsigned 64-bit integer to the console.
+ * 
+ * This function draws the provided integer to the console at the
+ * given position, padded to at least the given width.
+ * 
+ * @param x The X position to draw the integer to.
+ * @param y The Y position to draw the integer to.
+ * @param value The integer to draw to the console.
+ * @param width The minimum number of columns to fill, up to 64.
+ * @param flags A combination of the `CFW_FORMAT_*` flags.
+ */
+CFWAPI void cfw_draw_uint64(int x, int y, uint64_t value, int width, int flags);
+
 /**
  * @brief Draw a float to the console.
  * 
  * This function draws the provided float to the console at the given
- * position.
+ * position, with the fewest digits that still read back as the same
+ * float. Very large and very small floats are drawn in exponent
+ * notation, like `1.5e+30`.
  * 
  * @param x The X position to draw the float to.
  * @param y The Y position to draw the float to.
@@ -575,6 +899,42 @@ CFWAPI void cfw_draw_int(int x, int y, int i);
  */
 CFWAPI void cfw_draw_float(int x, int y, float f);
 
+/**
+ * @brief Draw a number with a fixed number of decimals to the console.
+ * 
+ * This function draws the provided number to the console at the given
+ * position, rounded to the given number of decimals and padded to at
+ * least the given width. The exact value of the double is rounded,
+ * with ties to even, so the decimals match those printf writes.
+ * Numbers too large to be rounded exactly are drawn in exponent
+ * notation.
+ * 
+ * @param x The X position to draw the number to.
+ * @param y The Y position to draw the number to.
+ * @param value The number to draw to the console.
+ * @param width The minimum number of columns to fill, up to 64.
+ * @param precision The number of decimals, up to 17.
+ * @param flags A combination of the `CFW_FORMAT_*` flags.
+ */
+CFWAPI void cfw_draw_fixed(int x, int y, double value, int width, int precision, int flags);
+
+/**
+ * @brief Draw a number with a metric prefix to the console.
+ * 
+ * This function draws the provided number to the console at the given
+ * position like `cfw_draw_fixed`, scaled by the SI prefix from pico
+ * to exa that leaves between 1 and 1000 of it, like `4.70k` or
+ * `12.5µ`.
+ * 
+ * @param x The X position to draw the number to.
+ * @param y The Y position to draw the number to.
+ * @param value The number to draw to the console.
+ * @param width The minimum number of columns to fill, up to 64.
+ * @param precision The number of decimals, up to 17.
+ * @param flags A combination of the `CFW_FORMAT_*` flags.
+ */
+CFWAPI void cfw_draw_metric(int x, int y, double value, int width, int precision, int flags);
+
 /**
  * @brief Draw a boolean to the console.
  * 
@@ -603,12 +963,60 @@ CFWAPI void cfw_draw_bool(int x, int y, cfw__bool b);
  */
 CFWAPI void cfw_draw_line(int x1, int y1, int x2, int y2, char c);
 
+/**
+ * @brief Draw a polyline to the console.
+ * 
+ * This function draws lines of the set character between each pair
+ * of consecutive points, like `cfw_draw_line`. The tile where two
+ * lines meet is only drawn once. In `CFW_POINTS` mode only the
+ * points themselves are drawn.
+ * 
+ * @code
+ * int xy[] = { 0, 10, 5, 2, 10, 8, 15, 4 };
+ * cfw_draw_polyline(xy, 4, '*');
+ * @endcode
+ * 
+ * @param xy The X and Y positions of the points, one after another.
+ * @param count The number of points.
+ * @param c The character to draw the lines with.
+ */
+CFWAPI void cfw_draw_polyline(const int *xy, size_t count, char c);
+
+/**
+ * @brief Draw points to the console.
+ * 
+ * This function draws the set character at each of the given
+ * points, like `cfw_draw_char`.
+ * 
+ * @param xy The X and Y positions of the points, one after another.
+ * @param count The number of points.
+ * @param c The character to draw at the points.
+ */
+CFWAPI void cfw_draw_points(const int *xy, size_t count, char c);
+
+/**
+ * @brief Draw a polygon to the console.
+ * 
+ * This function draws a polygon with any number of points, which
+ * can be concave and can cross itself. In `CFW_FILL` mode, the cells
+ * inside the polygon by the fill rule set with `cfw_fill_rule` are
+ * filled. In `CFW_LINES` mode, the outline is drawn, closing the
+ * polygon from the last point back to the first.
+ * 
+ * @param xy The X and Y positions of the points, one after another.
+ * @param count The number of points.
+ * @param c The character to draw the polygon with.
+ */
+CFWAPI void cfw_draw_polygon(const int *xy, size_t count, char c);
+
 /**
  * @brief Draw a triangle polygon to the console.
  * 
  * This function draws a triange of the set character to the console.
  * 
- * The triangle is drawn between the three points given.
+ * The triangle is drawn between the three points given. When the
+ * triangle is filled, the cells on its right and bottom edges are
+ * left out, so triangles sharing an edge never overlap.
  * 
  * @param x1 The X position of the first point.
  * @param y1 The Y position of the first point.
@@ -627,7 +1035,8 @@ CFWAPI void cfw_draw_triangle(int x1, int y1, int x2,
  * This function draws a quad of the set character to the console.
  * 
  * The quad is drawn within the area defined by the four given
- * points.
+ * points. When the quad is filled, the cells on its right and bottom
+ * edges are left out, like for triangles.
  * 
  * @param x1 The X position of the first point.
  * @param y1 The Y position of the first point.
@@ -656,6 +1065,83 @@ CFWAPI void cfw_draw_quad(int x1, int y1,
  */
 CFWAPI void cfw_draw_circle(int x, int y, int radius, char c);
 
+/**
+ * @brief Draw an ellipse polygon to the console.
+ * 
+ * This function draws an axis-aligned ellipse of the set character
+ * to the console.
+ * 
+ * @param x The X position of the center of the ellipse.
+ * @param y The Y position of the center of the ellipse.
+ * @param radius_x The horizontal radius of the ellipse.
+ * @param radius_y The vertical radius of the ellipse.
+ * @param c The character to draw the ellipse with.
+ */
+CFWAPI void cfw_draw_ellipse(int x, int y, int radius_x, int radius_y, char c);
+
+/**
+ * @brief Fill a rectangle of the console.
+ * 
+ * This function fills the given rectangle with the set character,
+ * using the current colors. Unlike the polygons, the rectangle is
+ * always filled, regardless of the polygon mode.
+ * 
+ * @param x The X position of the top left corner of the rectangle.
+ * @param y The Y position of the top left corner of the rectangle.
+ * @param width The width of the rectangle.
+ * @param height The height of the rectangle.
+ * @param c The character to fill the rectangle with.
+ */
+CFWAPI void cfw_fill_rect(int x, int y, int width, int height, char c);
+
+/**
+ * @brief Flood fill an area of the console.
+ * 
+ * This function fills the area around the given position with the
+ * set character, using the current colors. The area is made up of
+ * the cells connected to the given one, horizontally or vertically,
+ * that have the same character and colors as it. The fill doesn't
+ * leave the current region.
+ * 
+ * The cells drawn since the last refresh are filled, so an area
+ * drawn with the polygon functions can be filled right away.
+ * 
+ * @param x The X position to start the fill from.
+ * @param y The Y position to start the fill from.
+ * @param c The character to fill the area with.
+ */
+CFWAPI void cfw_flood_fill(int x, int y, char c);
+
+/**
+ * @brief Draw an image to the console.
+ * 
+ * This function draws an image of 8-bit RGB pixels, two pixels to
+ * a cell. Every cell is an upper half block, with the upper pixel as
+ * its foreground color and the lower pixel as its background color.
+ * When the height is odd, the last row of cells has the current
+ * background color below the pixels. On consoles without 24-bit
+ * colors, the pixels are dithered to the colors of the console as
+ * set with `cfw_dither_mode`.
+ * 
+ * To use this function, `CFW_COLORS` has to be enabled.
+ * 
+ * @code
+ * // A 16x16 image takes up 16x8 cells
+ * uint8_t pixels[16 * 16 * 3];
+ * cfw_blit_rgb(0, 0, pixels, 16, 16, 16 * 3);
+ * @endcode
+ * 
+ * @param x The X position of the top left cell of the image.
+ * @param y The Y position of the top left cell of the image.
+ * @param rgb The red, green and blue byte of every pixel, going right
+ * and then down.
+ * @param width The width of the image in pixels.
+ * @param height The height of the image in pixels.
+ * @param stride The number of bytes from one row of pixels to the
+ * next, at least 3 times the width.
+ */
+CFWAPI void cfw_blit_rgb(int x, int y, const uint8_t *rgb, int width, int height, int stride);
+
 #ifdef __cplusplus
 }
 #endif
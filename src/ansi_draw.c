@@ -0,0 +1,701 @@
+/**
+ * @file ansi_draw.c
+ * @author Nicolai Frigaard
+ * @brief The ANSI implementation of platform-specific draw code.
+ *
+ * This file contains the ANSI implementation of the
+ * platform-specific draw code. Nothing is written to the console
+ * here, the escape sequences are collected in the output buffer
+ * until the console is refreshed.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <string.h>
+
+#include "internal.h"
+#include "ansi_internal.h"
+
+int get_ansi_color_id(int color)
+{
+    // CFW colors are ordered like the DOS palette, while ANSI swaps
+    // blue and red, and cyan and yellow
+    static const int ansi_colors[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+    return ansi_colors[color & 7];
+}
+
+int count_digits(int value)
+{
+    int digits = 1;
+    while (value >= 10)
+    {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+// Cursor movement methods, in the order they are tried
+#define MOVE_NONE       0
+#define MOVE_CR         1   // Carriage return, to the first column
+#define MOVE_FORWARD    2   // CUF - Cursor Forward
+#define MOVE_BACKWARD   3   // CUB - Cursor Backward
+#define MOVE_BACKSPACE  4   // Backspaces, one byte per column
+#define MOVE_COLUMN     5   // CHA - Cursor Horizontal Absolute
+#define MOVE_REPRINT    6   // Draw the cells that are already there
+
+#define MOVE_DOWN       1   // CUD - Cursor Down
+#define MOVE_UP         2   // CUU - Cursor Up
+#define MOVE_LINEFEED   3   // Line feeds, one byte per row
+#define MOVE_ROW        4   // VPA - Vertical Line Position Absolute
+#define MOVE_NEWLINE    5   // Carriage return and line feeds
+
+// The cost of a CSI sequence with a single parameter, where the
+// parameter is left out when it is the default of 1
+int csi_cost(int parameter)
+{
+    return (parameter == 1) ? 3 : 3 + count_digits(parameter);
+}
+
+void write_csi(int parameter, char final)
+{
+    _cfw_platform_ansi_write_str(_CFW_ANSI_CSI);
+    if (parameter != 1)
+        _cfw_platform_ansi_write_int(parameter);
+    _cfw_platform_ansi_write(&final, 1);
+}
+
+uint32_t resolve_color(uint32_t color, cfw__bool foreground, int *attributes);
+
+cfw__bool cell_has_console_attributes(const __cfw_cell *cell)
+{
+    const __cfw_style *style = &__cfw.styles[cell->style];
+
+    // The console is set to the colors the style resolved to, like
+    // in _cfw_platform_set_attributes
+    int attributes = style->attr;
+    uint32_t fg = resolve_color(style->fg, CFW_TRUE, &attributes);
+    uint32_t bg = resolve_color(style->bg, CFW_FALSE, &attributes);
+
+    return fg         == __cfw_ansi.fg_color &&
+           bg         == __cfw_ansi.bg_color &&
+           attributes == __cfw_ansi.attributes;
+}
+
+cfw__bool can_reprint(int from_x, int to_x, int y)
+{
+    // The cells between the two columns are already displayed, so
+    // drawing them again only moves the cursor, as long as they
+    // have the attributes currently set in the console
+    const __cfw_cell *cells = &__cfw.framebuffer.front[y * __cfw.framebuffer.width];
+
+    for (int x = from_x; x < to_x; x++)
+    {
+        if (cells[x].glyph < ' ' || cells[x].glyph > '~' ||
+            !cell_has_console_attributes(&cells[x]))
+            return CFW_FALSE;
+    }
+
+    return CFW_TRUE;
+}
+
+int horizontal_cost(int from_x, int to_x, int y, int limit, int *method)
+{
+    int distance = to_x - from_x;
+    int cost;
+
+    if (distance == 0)
+    {
+        *method = MOVE_NONE;
+        return 0;
+    }
+
+    // Absolute positioning always works
+    *method = MOVE_COLUMN;
+    cost = csi_cost(to_x + 1);
+
+    if (to_x == 0 && 1 < cost)
+    {
+        *method = MOVE_CR;
+        cost = 1;
+    }
+
+    if (distance > 0)
+    {
+        if (csi_cost(distance) < cost)
+        {
+            *method = MOVE_FORWARD;
+            cost = csi_cost(distance);
+        }
+
+        // Reprinting costs a byte per cell, so only check the cells
+        // when that can be cheaper
+        if (distance < min(cost, limit) && can_reprint(from_x, to_x, y))
+        {
+            *method = MOVE_REPRINT;
+            cost = distance;
+        }
+    }
+    else
+    {
+        if (csi_cost(-distance) < cost)
+        {
+            *method = MOVE_BACKWARD;
+            cost = csi_cost(-distance);
+        }
+
+        if (-distance < cost)
+        {
+            *method = MOVE_BACKSPACE;
+            cost = -distance;
+        }
+    }
+
+    return cost;
+}
+
+void move_horizontal(int from_x, int to_x, int y, int method)
+{
+    switch (method)
+    {
+    case MOVE_CR:
+        _cfw_platform_ansi_write("\r", 1);
+        break;
+    case MOVE_FORWARD:
+        write_csi(to_x - from_x, 'C');
+        break;
+    case MOVE_BACKWARD:
+        write_csi(from_x - to_x, 'D');
+        break;
+    case MOVE_BACKSPACE:
+        for (int x = to_x; x < from_x; x++)
+            _cfw_platform_ansi_write("\b", 1);
+        break;
+    case MOVE_COLUMN:
+        write_csi(to_x + 1, 'G');
+        break;
+    case MOVE_REPRINT:
+    {
+        // The cells are known to be printable ASCII
+        const __cfw_cell *cells = &__cfw.framebuffer.front[y * __cfw.framebuffer.width];
+        for (int x = from_x; x < to_x; x++)
+        {
+            char c = (char)cells[x].glyph;
+            _cfw_platform_ansi_write(&c, 1);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+void move_cursor(int x, int y)
+{
+    int cursor_x = __cfw_ansi.cursor_x;
+    int cursor_y = __cfw_ansi.cursor_y;
+
+    if (cursor_x == x && cursor_y == y)
+        return;
+
+    // CUP - Cursor Position. It can always be used, and is the only
+    // option when the position of the cursor is unknown.
+    int best_cost = (x == 0) ? csi_cost(y + 1)
+                             : 4 + count_digits(y + 1) + count_digits(x + 1);
+    int best_vertical = -1;
+    int best_horizontal = MOVE_NONE;
+
+    if (cursor_x >= 0 && cursor_y >= 0)
+    {
+        // Try every way of getting to the row, followed by the
+        // cheapest way of getting to the column from there
+        int distance = y - cursor_y;
+
+        for (int vertical = MOVE_NONE; vertical <= MOVE_NEWLINE; vertical++)
+        {
+            int cost, column = cursor_x;
+
+            switch (vertical)
+            {
+            case MOVE_NONE:
+                if (distance != 0) continue;
+                cost = 0;
+                break;
+            case MOVE_DOWN:
+                if (distance <= 0) continue;
+                cost = csi_cost(distance);
+                break;
+            case MOVE_UP:
+                if (distance >= 0) continue;
+                cost = csi_cost(-distance);
+                break;
+            case MOVE_LINEFEED:
+                if (distance <= 0) continue;
+                cost = distance;
+                break;
+            case MOVE_ROW:
+                if (distance == 0) continue;
+                cost = csi_cost(y + 1);
+                break;
+            case MOVE_NEWLINE:
+                if (distance <= 0) continue;
+                cost = 1 + distance;
+                column = 0;
+                break;
+
+            default:
+                continue;
+            }
+
+            if (cost >= best_cost)
+                continue;
+
+            int horizontal;
+            cost += horizontal_cost(column, x, y, best_cost - cost, &horizontal);
+
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_vertical = vertical;
+                best_horizontal = horizontal;
+            }
+        }
+    }
+
+    switch (best_vertical)
+    {
+    case -1:
+        // CUP, where the column can be left out for the first one
+        if (x == 0)
+            write_csi(y + 1, 'H');
+        else
+        {
+            _cfw_platform_ansi_write_str(_CFW_ANSI_CSI);
+            _cfw_platform_ansi_write_int(y + 1);
+            _cfw_platform_ansi_write(";", 1);
+            _cfw_platform_ansi_write_int(x + 1);
+            _cfw_platform_ansi_write("H", 1);
+        }
+        break;
+    case MOVE_DOWN:
+        write_csi(y - cursor_y, 'B');
+        break;
+    case MOVE_UP:
+        write_csi(cursor_y - y, 'A');
+        break;
+    case MOVE_LINEFEED:
+        for (int i = cursor_y; i < y; i++)
+            _cfw_platform_ansi_write("\n", 1);
+        break;
+    case MOVE_ROW:
+        write_csi(y + 1, 'd');
+        break;
+    case MOVE_NEWLINE:
+        _cfw_platform_ansi_write("\r", 1);
+        for (int i = cursor_y; i < y; i++)
+            _cfw_platform_ansi_write("\n", 1);
+        cursor_x = 0;
+        break;
+
+    default:
+        break;
+    }
+
+    if (best_vertical != -1)
+        move_horizontal(cursor_x, x, y, best_horizontal);
+
+    __cfw_ansi.cursor_x = x;
+    __cfw_ansi.cursor_y = y;
+}
+
+int append_int(char *out, int value)
+{
+    char digits[12];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = '0' + (value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    for (int i = 0; i < count; i++)
+        out[i] = digits[count - 1 - i];
+
+    return count;
+}
+
+uint32_t resolve_color(uint32_t color, cfw__bool foreground, int *attributes)
+{
+    if (_CFW_COLOR_KIND(color) != _CFW_COLOR_RGB || __cfw_ansi.capabilities.colors > 256)
+        return color;
+
+    int value = _CFW_COLOR_VALUE(color);
+
+    // RGB colors are turned into the closest color the console has
+    // up front, so colors that end up the same don't cause the
+    // attributes to be sent again
+    if (__cfw_ansi.capabilities.colors == 256)
+        return _CFW_COLOR_256 | _cfw_color_to_256(value);
+
+    if (!foreground)
+        return _CFW_COLOR_PALETTE | _cfw_color_to_8(value);
+
+    // With only 16 colors, the bright half of the colors is drawn
+    // as bold text, like the bold CFW colors
+    int basic = _cfw_color_to_16(value);
+    if (basic & 8)
+        *attributes |= _CFW_ATTR_BOLD;
+
+    return _CFW_COLOR_PALETTE | (basic & 7);
+}
+
+// Longest color parameter, "38;2;255;255;255"
+#define MAX_COLOR_PARAMETER 16
+
+int format_color(char *out, uint32_t color, int base)
+{
+    int value = _CFW_COLOR_VALUE(color);
+    int length;
+
+    switch (_CFW_COLOR_KIND(color))
+    {
+    case _CFW_COLOR_PALETTE:
+        return append_int(out, base + get_ansi_color_id(value));
+
+    case _CFW_COLOR_RGB:
+        // 24-bit color
+        length = append_int(out, base + 8);
+        memcpy(&out[length], ";2;", 3);
+        length += 3;
+        length += append_int(&out[length], value >> 16);
+        out[length++] = ';';
+        length += append_int(&out[length], (value >> 8) & 0xFF);
+        out[length++] = ';';
+        length += append_int(&out[length], value & 0xFF);
+        return length;
+
+    case _CFW_COLOR_256:
+        // One of the 256 palette colors
+        length = append_int(out, base + 8);
+        memcpy(&out[length], ";5;", 3);
+        length += 3;
+        length += append_int(&out[length], value);
+        return length;
+
+    default:
+        // The console default
+        return append_int(out, base + 9);
+    }
+}
+
+void write_sgr_parameter(const char *parameter, int length, int *count)
+{
+    if ((*count)++ > 0)
+        _cfw_platform_ansi_write(";", 1);
+    _cfw_platform_ansi_write(parameter, length);
+}
+
+// SGR parameters turning each attribute on and off
+static const struct
+{
+    int         attribute;
+    const char  *on;
+    const char  *off;
+} sgr_attributes[] =
+{
+    { _CFW_ATTR_BOLD,       "1", "22" },
+    { _CFW_ATTR_UNDERLINE,  "4", "24" },
+    { _CFW_ATTR_REVERSE,    "7", "27" },
+};
+
+#define SGR_ATTRIBUTE_COUNT (int)(sizeof(sgr_attributes) / sizeof(sgr_attributes[0]))
+
+void update_attributes(void)
+{
+    uint32_t fg_color = __cfw_ansi.next_fg_color;
+    uint32_t bg_color = __cfw_ansi.next_bg_color;
+    int attributes    = __cfw_ansi.next_attributes;
+
+    cfw__bool fg_changed = (fg_color != __cfw_ansi.fg_color);
+    cfw__bool bg_changed = (bg_color != __cfw_ansi.bg_color);
+    int changed = attributes ^ __cfw_ansi.attributes;
+
+    __cfw_ansi.fg_color   = fg_color;
+    __cfw_ansi.bg_color   = bg_color;
+    __cfw_ansi.attributes = attributes;
+
+    // Only send the attributes when they differ from what the
+    // console is already set to
+    if (!fg_changed && !bg_changed && changed == 0)
+        return;
+
+    char fg_parameter[MAX_COLOR_PARAMETER];
+    char bg_parameter[MAX_COLOR_PARAMETER];
+    int fg_length = format_color(fg_parameter, fg_color, 30);
+    int bg_length = format_color(bg_parameter, bg_color, 40);
+
+    cfw__bool fg_default = (fg_color == _CFW_COLOR_DEFAULT);
+    cfw__bool bg_default = (bg_color == _CFW_COLOR_DEFAULT);
+
+    // Either change what differs, or reset everything and set the
+    // attributes from scratch, whichever is shorter. Without support
+    // for turning single attributes off, everything has to be reset
+    // whenever an attribute is removed.
+    int reset_cost = 1 + (fg_default ? 0 : 1 + fg_length) +
+                         (bg_default ? 0 : 1 + bg_length);
+    int delta_cost = (fg_changed ? 1 + fg_length : 0) +
+                     (bg_changed ? 1 + bg_length : 0) - 1;
+
+    for (int i = 0; i < SGR_ATTRIBUTE_COUNT; i++)
+    {
+        int attribute = sgr_attributes[i].attribute;
+
+        if (attributes & attribute)
+            reset_cost += 1 + (int)strlen(sgr_attributes[i].on);
+        if (changed & attribute)
+            delta_cost += 1 + (int)strlen((attributes & attribute) ?
+                                          sgr_attributes[i].on : sgr_attributes[i].off);
+    }
+
+    cfw__bool removes = (changed & ~attributes) != 0 ||
+                        (fg_changed && fg_default) ||
+                        (bg_changed && bg_default);
+    cfw__bool reset = (removes && !__cfw_ansi.capabilities.attributes_off) ||
+                      reset_cost < delta_cost;
+
+    // SGR - Select Graphic Rendition
+    int count = 0;
+    _cfw_platform_ansi_write_str(_CFW_ANSI_CSI);
+
+    if (reset)
+    {
+        write_sgr_parameter("0", 1, &count);
+
+        // Bold colors are drawn as bold text, like with Curses
+        for (int i = 0; i < SGR_ATTRIBUTE_COUNT; i++)
+        {
+            if (attributes & sgr_attributes[i].attribute)
+                write_sgr_parameter(sgr_attributes[i].on, (int)strlen(sgr_attributes[i].on), &count);
+        }
+        if (!fg_default)
+            write_sgr_parameter(fg_parameter, fg_length, &count);
+        if (!bg_default)
+            write_sgr_parameter(bg_parameter, bg_length, &count);
+    }
+    else
+    {
+        for (int i = 0; i < SGR_ATTRIBUTE_COUNT; i++)
+        {
+            if (!(changed & sgr_attributes[i].attribute))
+                continue;
+
+            const char *parameter = (attributes & sgr_attributes[i].attribute) ?
+                                    sgr_attributes[i].on : sgr_attributes[i].off;
+            write_sgr_parameter(parameter, (int)strlen(parameter), &count);
+        }
+        if (fg_changed)
+            write_sgr_parameter(fg_parameter, fg_length, &count);
+        if (bg_changed)
+            write_sgr_parameter(bg_parameter, bg_length, &count);
+    }
+
+    _cfw_platform_ansi_write("m", 1);
+}
+
+cfw__bool erase_keeps_attributes(void)
+{
+    // Erased cells are never underlined, and get the background
+    // color even when the colors are reversed
+    return !(__cfw_ansi.attributes & (_CFW_ATTR_UNDERLINE | _CFW_ATTR_REVERSE));
+}
+
+cfw__bool can_erase(void)
+{
+    // Erased cells get the background color on consoles that
+    // support it, and the default color on the others
+    return erase_keeps_attributes() &&
+           (__cfw_ansi.capabilities.erase || __cfw_ansi.bg_color == _CFW_COLOR_DEFAULT);
+}
+
+void write_glyph(uint32_t glyph, int count)
+{
+    const char *bytes;
+    char codepoint[4];
+    int size;
+
+    if (glyph & _CFW_GLYPH_GRAPHEME)
+    {
+        const __cfw_grapheme *grapheme = &__cfw.graphemes[glyph & ~_CFW_GLYPH_GRAPHEME];
+        bytes = grapheme->text;
+        size = grapheme->length;
+    }
+    else
+    {
+        size = _cfw_utf8_encode(glyph, codepoint);
+        bytes = codepoint;
+    }
+
+    for (int i = 0; i < count; i++)
+        _cfw_platform_ansi_write(bytes, size);
+}
+
+void sync_resumed_console(void)
+{
+    if (!__cfw_ansi_resumed)
+        return;
+
+    // Where the cursor is and which attributes are set isn't known
+    // after the application has been stopped, so the attributes are
+    // reset and the cursor is moved with absolute positions
+    __cfw_ansi_resumed = 0;
+
+    // Leaving the alternate screen lost everything that was drawn.
+    // In the middle of a flush, the framebuffer draws everything
+    // again once the flush is done.
+    _cfw_framebuffer_invalidate();
+
+    _cfw_platform_ansi_write_str(_CFW_ANSI_CSI "0m");
+    __cfw_ansi.fg_color = _CFW_COLOR_DEFAULT;
+    __cfw_ansi.bg_color = _CFW_COLOR_DEFAULT;
+    __cfw_ansi.attributes = 0;
+    __cfw_ansi.cursor_x = -1;
+    __cfw_ansi.cursor_y = -1;
+}
+
+void write_text(int x, int y, const __cfw_cell *cells, int length)
+{
+    int width = __cfw.framebuffer.width;
+
+    // Move first, as reprinting cells uses the current attributes
+    move_cursor(x, y);
+    update_attributes();
+
+    // Where the cursor ends up. Erasing doesn't move the cursor.
+    int cursor_x = x + length;
+
+    for (int i = 0; i < length; )
+    {
+        // The second half of a double-width character is drawn along
+        // with the first one
+        uint32_t c = cells[i].glyph;
+        if (c == _CFW_GLYPH_CONTINUATION)
+        {
+            i++;
+            continue;
+        }
+
+        // Find the run of identical characters
+        int run = 1;
+        while (i + run < length && cells[i + run].glyph == c)
+            run++;
+
+        cfw__bool last = (i + run == length);
+
+        if (c == ' ' && last && x + length == width && 3 < run && can_erase())
+        {
+            // EL - Erase in Line, clears everything up to the end of
+            // the line
+            _cfw_platform_ansi_write_str(_CFW_ANSI_CSI "K");
+            cursor_x = x + i;
+        }
+        else if (c == ' ' && __cfw_ansi.capabilities.erase && erase_keeps_attributes() &&
+                 csi_cost(run) + (last ? 0 : csi_cost(run)) < run)
+        {
+            // ECH - Erase Character. The cursor has to be moved past
+            // the erased cells if more text follows.
+            write_csi(run, 'X');
+            if (last)
+                cursor_x = x + i;
+            else
+                write_csi(run, 'C');
+        }
+        else if (__cfw_ansi.capabilities.repeat && c >= ' ' && c <= '~' &&
+                 1 + csi_cost(run - 1) < run)
+        {
+            // REP - Repeat the preceding graphic character
+            write_glyph(c, 1);
+            write_csi(run - 1, 'b');
+        }
+        else
+            write_glyph(c, run);
+
+        i += run;
+    }
+
+    // When the last column is written, the console keeps the cursor
+    // there until the next character is drawn, so its position is no
+    // longer reliable
+    __cfw_ansi.cursor_x = (cursor_x >= width) ? -1 : cursor_x;
+}
+
+// ------------------------------------------------------------------
+// |                        CFW platform API                        |
+// ------------------------------------------------------------------
+
+void _cfw_platform_sync(void)
+{
+    sync_resumed_console();
+}
+
+void _cfw_platform_clear(void)
+{
+    sync_resumed_console();
+    _cfw_platform_ansi_write_str(_CFW_ANSI_CSI "0m" _CFW_ANSI_CSI "2J");
+
+    __cfw_ansi.fg_color = _CFW_COLOR_DEFAULT;
+    __cfw_ansi.bg_color = _CFW_COLOR_DEFAULT;
+    __cfw_ansi.attributes = 0;
+}
+
+void _cfw_platform_set_attributes(uint32_t fg_color, uint32_t bg_color, int attributes)
+{
+    __cfw_ansi.next_fg_color = resolve_color(fg_color, CFW_TRUE, &attributes);
+    __cfw_ansi.next_bg_color = resolve_color(bg_color, CFW_FALSE, &attributes);
+    __cfw_ansi.next_attributes = attributes;
+}
+
+void _cfw_platform_draw_cells(int x, int y, const __cfw_cell *cells, int length)
+{
+    sync_resumed_console();
+    write_text(x, y, cells, length);
+}
+
+cfw__bool _cfw_platform_scroll(int top, int bottom, int lines)
+{
+    sync_resumed_console();
+
+    // The rows scrolled in are blank with the default colors. The
+    // attributes of the next text are kept, as CFW only sets them
+    // when they change.
+    uint32_t fg_color = __cfw_ansi.next_fg_color;
+    uint32_t bg_color = __cfw_ansi.next_bg_color;
+    int attributes = __cfw_ansi.next_attributes;
+
+    _cfw_platform_set_attributes(_CFW_COLOR_DEFAULT, _CFW_COLOR_DEFAULT, 0);
+    update_attributes();
+    _cfw_platform_set_attributes(fg_color, bg_color, attributes);
+
+    // DECSTBM - Set Top and Bottom Margins
+    _cfw_platform_ansi_write_str(_CFW_ANSI_CSI);
+    _cfw_platform_ansi_write_int(top + 1);
+    _cfw_platform_ansi_write(";", 1);
+    _cfw_platform_ansi_write_int(bottom + 1);
+    _cfw_platform_ansi_write("r", 1);
+
+    // DL - Delete Line and IL - Insert Line, at the top margin. They
+    // move the rows below the cursor up or down within the margins.
+    write_csi(top + 1, 'H');
+    if (lines > 0)
+        write_csi(lines, 'M');
+    else
+        write_csi(-lines, 'L');
+
+    // Reset the margins, which moves the cursor to the home position
+    _cfw_platform_ansi_write_str(_CFW_ANSI_CSI "r");
+    __cfw_ansi.cursor_x = 0;
+    __cfw_ansi.cursor_y = 0;
+
+    return CFW_TRUE;
+}
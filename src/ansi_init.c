@@ -0,0 +1,507 @@
+/**
+ * @file ansi_init.c
+ * @author Nicolai Frigaard
+ * @brief The ANSI implementation of platform-specific init code.
+ *
+ * This file contains the ANSI implementation of the
+ * platform-specific init code. The console is put in raw mode with
+ * termios, and everything is drawn with VT100/xterm escape
+ * sequences collected in a single output buffer.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "ansi_internal.h"
+
+// Global ANSI backend state
+__cfw_ansi_state __cfw_ansi;
+
+// Signal handlers replaced while CFW is initialized
+struct sigaction __cfw_ansi_old_sigint;
+struct sigaction __cfw_ansi_old_sigterm;
+struct sigaction __cfw_ansi_old_sigtstp;
+struct sigaction __cfw_ansi_old_sigcont;
+
+volatile sig_atomic_t __cfw_ansi_resumed = 0;
+
+// Set while the application is stopped by SIGTSTP
+volatile sig_atomic_t __cfw_ansi_stopped = 0;
+
+// Reset attributes, show the cursor and leave the alternate screen
+#define RESTORE_SEQUENCE _CFW_ANSI_CSI "0m" _CFW_ANSI_CSI "?25h" _CFW_ANSI_CSI "?1049l"
+
+// Enter the alternate screen and hide the cursor
+#define ENTER_SEQUENCE _CFW_ANSI_CSI "?1049h" _CFW_ANSI_CSI "?25l"
+
+void restore_console(void)
+{
+    if (!__cfw_ansi.active)
+        return;
+
+    _cfw_platform_ansi_write_str(RESTORE_SEQUENCE);
+    _cfw_platform_ansi_flush();
+
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &__cfw_ansi.original_termios);
+    __cfw_ansi.active = CFW_FALSE;
+}
+
+void write_signal_safe(const char *str, size_t size)
+{
+    // Signal handlers can't use the output buffer, which may be in
+    // the middle of being written to or reallocated
+    while (size > 0)
+    {
+        ssize_t result = write(STDOUT_FILENO, str, size);
+        if (result < 0 && errno != EINTR)
+            return;
+        if (result > 0)
+        {
+            str += result;
+            size -= result;
+        }
+    }
+}
+
+void handle_signal(int signal);
+
+void install_handler(int signal, struct sigaction *old)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(signal, &action, old);
+}
+
+void handle_signal(int signal)
+{
+    // Only async-signal-safe functions can be called in here
+    int saved_errno = errno;
+
+    switch (signal)
+    {
+    case SIGTSTP:
+        // Give the console back while the application is stopped.
+        // The stop signal is delivered with the handler the
+        // application had once this handler returns.
+        write_signal_safe(RESTORE_SEQUENCE, sizeof(RESTORE_SEQUENCE) - 1);
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &__cfw_ansi.original_termios);
+        __cfw_ansi_stopped = 1;
+
+        sigaction(SIGTSTP, &__cfw_ansi_old_sigtstp, NULL);
+        raise(SIGTSTP);
+        break;
+
+    case SIGCONT:
+        // The shell may have changed the terminal settings while the
+        // application was stopped, so raw mode is always set again
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &__cfw_ansi.raw_termios);
+        if (__cfw_ansi_stopped)
+        {
+            write_signal_safe(ENTER_SEQUENCE, sizeof(ENTER_SEQUENCE) - 1);
+            install_handler(SIGTSTP, NULL);
+            __cfw_ansi_stopped = 0;
+        }
+
+        // Everything is drawn again on the next refresh. The
+        // framebuffer may be in the middle of a flush, so it is only
+        // invalidated once the flag is seen outside the handler.
+        __cfw_ansi_resumed = 1;
+        break;
+
+    default:
+        // Give the console back before the application is killed
+        write_signal_safe(RESTORE_SEQUENCE, sizeof(RESTORE_SEQUENCE) - 1);
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &__cfw_ansi.original_termios);
+        __cfw_ansi.active = CFW_FALSE;
+
+        sigaction(SIGINT, &__cfw_ansi_old_sigint, NULL);
+        sigaction(SIGTERM, &__cfw_ansi_old_sigterm, NULL);
+        sigaction(SIGTSTP, &__cfw_ansi_old_sigtstp, NULL);
+        sigaction(SIGCONT, &__cfw_ansi_old_sigcont, NULL);
+        raise(signal);
+        break;
+    }
+
+    errno = saved_errno;
+}
+
+// How long to wait for the console to answer the capability probe
+#define PROBE_TIMEOUT_MS 100
+
+int parse_parameter(const unsigned char **p, const unsigned char *end)
+{
+    int value = 0;
+    while (*p < end && **p >= '0' && **p <= '9')
+        value = value * 10 + (*(*p)++ - '0');
+    return value;
+}
+
+int parse_probe_responses(const unsigned char *data, int size, int *column)
+{
+    const unsigned char *end = &data[size];
+    int level = -1;
+
+    // Everything that isn't a response is kept as regular input
+    __cfw_ansi.input_size = 0;
+
+    for (const unsigned char *p = data; p < end; )
+    {
+        if (p[0] == 033 && p + 1 < end && p[1] == '[')
+        {
+            const unsigned char *q = p + 2;
+
+            if (q < end && *q == '?')
+            {
+                // DA1 - Primary Device Attributes: CSI ? level ; ... c
+                q++;
+                int value = parse_parameter(&q, end);
+                while (q < end && ((*q >= '0' && *q <= '9') || *q == ';'))
+                    q++;
+
+                if (q < end && *q == 'c')
+                {
+                    level = value;
+                    p = q + 1;
+                    continue;
+                }
+            }
+            else
+            {
+                // CPR - Cursor Position Report: CSI row ; column R
+                parse_parameter(&q, end);
+                if (q < end && *q == ';')
+                {
+                    q++;
+                    int value = parse_parameter(&q, end);
+                    if (q < end && *q == 'R')
+                    {
+                        *column = value;
+                        p = q + 1;
+                        continue;
+                    }
+                }
+            }
+        }
+
+        if (__cfw_ansi.input_size < (int)sizeof(__cfw_ansi.input))
+            __cfw_ansi.input[__cfw_ansi.input_size++] = *p;
+        p++;
+    }
+
+    return level;
+}
+
+int get_color_count(void)
+{
+    const char *colorterm = getenv("COLORTERM");
+    const char *term = getenv("TERM");
+
+    if (colorterm != NULL &&
+        (strcmp(colorterm, "truecolor") == 0 || strcmp(colorterm, "24bit") == 0))
+        return 0x1000000;
+
+    if (term != NULL)
+    {
+        if (strstr(term, "direct") != NULL)
+            return 0x1000000;
+        if (strstr(term, "256color") != NULL)
+            return 256;
+    }
+
+    return 16;
+}
+
+void probe_capabilities(void)
+{
+    unsigned char response[128];
+    int size = 0, level = -1, column = 0;
+    const char *term = getenv("TERM");
+
+    memset(&__cfw_ansi.capabilities, 0, sizeof(__cfw_ansi.capabilities));
+
+    // Consoles don't answer how many colors they have, but their
+    // environment variables usually tell
+    __cfw_ansi.capabilities.colors = get_color_count();
+
+    // Draw a character and repeat it, then ask for the cursor
+    // position (DSR) and the device attributes (DA1). The cursor
+    // only ends up in the third column if REP is supported. Consoles
+    // answer in order, so the device attributes always arrive last.
+    _cfw_platform_ansi_write_str(_CFW_ANSI_CSI "H" "x" _CFW_ANSI_CSI "b"
+                                 _CFW_ANSI_CSI "6n" _CFW_ANSI_CSI "c");
+    _cfw_platform_ansi_flush();
+
+    while (level < 0 && size < (int)sizeof(response))
+    {
+        struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+        if (poll(&fd, 1, PROBE_TIMEOUT_MS) <= 0)
+            break; // The console doesn't answer
+
+        ssize_t count = read(STDIN_FILENO, &response[size], sizeof(response) - size);
+        if (count <= 0)
+            break;
+
+        size += count;
+        level = parse_probe_responses(response, size, &column);
+    }
+
+    // Without an answer, only the sequences every console supports
+    // are used
+    if (level < 0)
+        return;
+
+    __cfw_ansi.capabilities.repeat = (column == 3);
+
+    // ECH, and erasing with the background color, came with the
+    // VT220 and are supported by all modern emulators. The Linux
+    // console only claims to be a VT102, but supports both.
+    __cfw_ansi.capabilities.erase = (level >= 62 ||
+                                     (term != NULL && strncmp(term, "linux", 5) == 0));
+
+    // Consoles with color support that are that recent also turn
+    // single attributes off
+    __cfw_ansi.capabilities.attributes_off = __cfw_ansi.capabilities.erase;
+}
+
+// ------------------------------------------------------------------
+// |                   CFW internal platform API                    |
+// ------------------------------------------------------------------
+
+void _cfw_platform_ansi_write(const char *data, size_t size)
+{
+    // Grow the output buffer if the data doesn't fit
+    if (__cfw_ansi.output_size + size > __cfw_ansi.output_capacity)
+    {
+        size_t capacity = max(__cfw_ansi.output_capacity * 2, 4096);
+        while (capacity < __cfw_ansi.output_size + size)
+            capacity *= 2;
+
+        char *output = realloc(__cfw_ansi.output, capacity);
+        if (output == NULL)
+        {
+            _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+            return;
+        }
+
+        __cfw_ansi.output = output;
+        __cfw_ansi.output_capacity = capacity;
+    }
+
+    memcpy(&__cfw_ansi.output[__cfw_ansi.output_size], data, size);
+    __cfw_ansi.output_size += size;
+}
+
+void _cfw_platform_ansi_write_str(const char *str)
+{
+    _cfw_platform_ansi_write(str, strlen(str));
+}
+
+void _cfw_platform_ansi_write_int(int value)
+{
+    char digits[12];
+    int i = sizeof(digits);
+    unsigned int u = (value < 0) ? -(unsigned int)value : (unsigned int)value;
+
+    do
+    {
+        digits[--i] = '0' + (u % 10);
+        u /= 10;
+    } while (u != 0);
+
+    if (value < 0)
+        digits[--i] = '-';
+
+    _cfw_platform_ansi_write(&digits[i], sizeof(digits) - i);
+}
+
+cfw__bool _cfw_platform_ansi_flush(void)
+{
+    size_t written = 0;
+
+    // Write the entire frame. A single write() is enough unless it
+    // gets interrupted or the console can't take it all at once.
+    while (written < __cfw_ansi.output_size)
+    {
+        ssize_t result = write(STDOUT_FILENO,
+                               &__cfw_ansi.output[written],
+                               __cfw_ansi.output_size - written);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            __cfw_ansi.output_size = 0;
+            return CFW_FALSE;
+        }
+
+        written += result;
+    }
+
+    __cfw_ansi.output_size = 0;
+    return CFW_TRUE;
+}
+
+// ------------------------------------------------------------------
+// |                        CFW platform API                        |
+// ------------------------------------------------------------------
+
+cfw__bool _cfw_platform_init(void)
+{
+    struct termios raw;
+
+    if (__cfw_ansi.active)
+        return CFW_TRUE;
+
+    if (tcgetattr(STDIN_FILENO, &__cfw_ansi.original_termios) != 0)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "The console is not a terminal.");
+        return CFW_FALSE;
+    }
+
+    // Don't echo, don't wait for a newline and don't translate any
+    // input or output. Signals are kept, so the application can
+    // still be interrupted.
+    raw = __cfw_ansi.original_termios;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_oflag &= ~(OPOST);
+    raw.c_cflag |= (CS8);
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "Failed to set the console to raw mode.");
+        return CFW_FALSE;
+    }
+
+    __cfw_ansi.raw_termios = raw;
+    __cfw_ansi.active = CFW_TRUE;
+    __cfw_ansi.input_size = 0;
+
+    // Restore the console if the application gets interrupted or
+    // stopped, and take it back when the application is continued
+    __cfw_ansi_resumed = 0;
+    __cfw_ansi_stopped = 0;
+    install_handler(SIGINT, &__cfw_ansi_old_sigint);
+    install_handler(SIGTERM, &__cfw_ansi_old_sigterm);
+    install_handler(SIGTSTP, &__cfw_ansi_old_sigtstp);
+    install_handler(SIGCONT, &__cfw_ansi_old_sigcont);
+
+    // Add the terminate call to an atexit to make sure that the
+    // console is restored at the absolute end of the application.
+    // The handler is only registered once.
+    static cfw__bool registered = CFW_FALSE;
+    if (!registered)
+    {
+        atexit(restore_console);
+        registered = CFW_TRUE;
+    }
+
+    _cfw_platform_ansi_write_str(ENTER_SEQUENCE);
+
+    // Find out which optional sequences can be used, before the
+    // screen is cleared
+    probe_capabilities();
+
+    _cfw_platform_ansi_write_str(_CFW_ANSI_CSI "0m"
+                                 _CFW_ANSI_CSI "H"
+                                 _CFW_ANSI_CSI "2J");
+
+    __cfw_ansi.cursor_x = 0;
+    __cfw_ansi.cursor_y = 0;
+    __cfw_ansi.fg_color = __cfw_ansi.next_fg_color = _CFW_COLOR_DEFAULT;
+    __cfw_ansi.bg_color = __cfw_ansi.next_bg_color = _CFW_COLOR_DEFAULT;
+    __cfw_ansi.attributes = __cfw_ansi.next_attributes = 0;
+
+    return _cfw_platform_ansi_flush();
+}
+
+void _cfw_platform_terminate(void)
+{
+    if (__cfw_ansi.active)
+    {
+        sigaction(SIGINT, &__cfw_ansi_old_sigint, NULL);
+        sigaction(SIGTERM, &__cfw_ansi_old_sigterm, NULL);
+        sigaction(SIGTSTP, &__cfw_ansi_old_sigtstp, NULL);
+        sigaction(SIGCONT, &__cfw_ansi_old_sigcont, NULL);
+    }
+
+    restore_console();
+
+    free(__cfw_ansi.output);
+    __cfw_ansi.output = NULL;
+    __cfw_ansi.output_size = 0;
+    __cfw_ansi.output_capacity = 0;
+}
+
+void _cfw_platform_refresh(void)
+{
+    _cfw_platform_ansi_flush();
+}
+
+cfw__bool _cfw_platform_is_feature_supported(int feature)
+{
+    const char *term;
+
+    switch (feature)
+    {
+    case CFW_COLORS:
+        // Every terminal except the dumb ones understand SGR colors
+        term = getenv("TERM");
+        return (term != NULL && strcmp(term, "dumb") != 0);
+
+    default:
+        _cfw_input_error(CFW_INVALID_VALUE, "0x%x is not a valid feature.", feature);
+        return CFW_FALSE;
+    }
+}
+
+void _cfw_platform_enable(int feature)
+{
+    switch (feature)
+    {
+    case CFW_COLORS:
+        // Colors are sent with every cell, nothing to set up
+        break;
+
+    default:
+        _cfw_input_error(CFW_INVALID_VALUE, "0x%x is not a valid feature.", feature);
+    }
+}
+
+int _cfw_platform_get_color_count(void)
+{
+    return __cfw_ansi.capabilities.colors;
+}
+
+void _cfw_platform_get_console_size(int *width, int *height)
+{
+    struct winsize size;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+    {
+        *width = size.ws_col;
+        *height = size.ws_row;
+    }
+    else
+    {
+        // Fall back to the size of a VT100
+        *width = 80;
+        *height = 24;
+    }
+}
@@ -0,0 +1,210 @@
+/**
+ * @file ansi_input.c
+ * @author Nicolai Frigaard
+ * @brief The ANSI implementation of platform-specific input code.
+ *
+ * This file contains the ANSI implementation of the
+ * platform-specific input code. Function keys arrive as escape
+ * sequences, which are decoded into CFW key codes here.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "ansi_internal.h"
+
+// How long to wait for the rest of an escape sequence before the
+// escape key is treated as a key press on its own
+#define ESCAPE_TIMEOUT_MS 25
+
+#define KEY_ESCAPE 033
+
+cfw__bool read_input(int timeout_ms)
+{
+    struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+    int space = sizeof(__cfw_ansi.input) - __cfw_ansi.input_size;
+
+    if (space <= 0)
+        return CFW_FALSE;
+
+    // Wait for input to arrive
+    int ready;
+    do
+        ready = poll(&fd, 1, timeout_ms);
+    while (ready < 0 && errno == EINTR);
+
+    if (ready <= 0)
+        return CFW_FALSE;
+
+    ssize_t count = read(STDIN_FILENO,
+                         &__cfw_ansi.input[__cfw_ansi.input_size], space);
+    if (count <= 0)
+        return CFW_FALSE;
+
+    __cfw_ansi.input_size += count;
+    return CFW_TRUE;
+}
+
+void consume_input(int count)
+{
+    __cfw_ansi.input_size -= count;
+    memmove(__cfw_ansi.input, &__cfw_ansi.input[count], __cfw_ansi.input_size);
+}
+
+int translate_tilde_key(int number)
+{
+    switch (number)
+    {
+    case 1:
+    case 7:  return CFW_KEY_HOME;
+    case 2:  return CFW_KEY_INSERT;
+    case 3:  return CFW_KEY_DELETE;
+
+    case 11: return CFW_KEY_F1;
+    case 12: return CFW_KEY_F2;
+    case 13: return CFW_KEY_F3;
+    case 14: return CFW_KEY_F4;
+    case 15: return CFW_KEY_F5;
+    case 17: return CFW_KEY_F6;
+    case 18: return CFW_KEY_F7;
+    case 19: return CFW_KEY_F8;
+    case 20: return CFW_KEY_F9;
+    case 21: return CFW_KEY_F10;
+    case 23: return CFW_KEY_F11;
+    case 24: return CFW_KEY_F12;
+
+    default: return CFW_NO_KEY;
+    }
+}
+
+int translate_final_key(unsigned char final)
+{
+    switch (final)
+    {
+    case 'A': return CFW_KEY_UP;
+    case 'B': return CFW_KEY_DOWN;
+    case 'C': return CFW_KEY_RIGHT;
+    case 'D': return CFW_KEY_LEFT;
+    case 'H': return CFW_KEY_HOME;
+
+    case 'P': return CFW_KEY_F1;
+    case 'Q': return CFW_KEY_F2;
+    case 'R': return CFW_KEY_F3;
+    case 'S': return CFW_KEY_F4;
+
+    default:  return CFW_NO_KEY;
+    }
+}
+
+int decode_escape_sequence(void)
+{
+    // Make sure the sequence has arrived in its entirety. A lone
+    // escape is the escape key itself.
+    if (__cfw_ansi.input_size < 2 && !read_input(ESCAPE_TIMEOUT_MS))
+    {
+        consume_input(1);
+        return KEY_ESCAPE;
+    }
+
+    unsigned char introducer = __cfw_ansi.input[1];
+    if (introducer != '[' && introducer != 'O')
+    {
+        consume_input(1);
+        return KEY_ESCAPE;
+    }
+
+    // Find the final byte of the sequence
+    int end = 2;
+    for (;;)
+    {
+        while (end < __cfw_ansi.input_size &&
+               !(__cfw_ansi.input[end] >= 0x40 && __cfw_ansi.input[end] <= 0x7E))
+            end++;
+
+        if (end < __cfw_ansi.input_size)
+            break;
+
+        if (!read_input(ESCAPE_TIMEOUT_MS))
+        {
+            // The sequence was never finished, so just treat the
+            // escape as a key press
+            consume_input(1);
+            return KEY_ESCAPE;
+        }
+    }
+
+    unsigned char final = __cfw_ansi.input[end];
+    int number = 0;
+    for (int i = 2; i < end && __cfw_ansi.input[i] >= '0' && __cfw_ansi.input[i] <= '9'; i++)
+        number = number * 10 + (__cfw_ansi.input[i] - '0');
+
+    consume_input(end + 1);
+
+    if (final == '~')
+        return translate_tilde_key(number);
+    else
+        return translate_final_key(final);
+}
+
+int read_key(int timeout_ms)
+{
+    for (;;)
+    {
+        if (__cfw_ansi.input_size == 0 && !read_input(timeout_ms))
+            return CFW_NO_KEY;
+
+        unsigned char c = __cfw_ansi.input[0];
+        int key;
+
+        switch (c)
+        {
+        case KEY_ESCAPE:
+            key = decode_escape_sequence();
+            break;
+        case '\r':
+        case '\n':
+            consume_input(1);
+            key = CFW_KEY_ENTER;
+            break;
+        case 010:
+        case 0177:
+            consume_input(1);
+            key = CFW_KEY_BACKSPACE;
+            break;
+
+        // If the key isn't a special key, assume it's a printable
+        // key, and return it un-modified.
+        default:
+            consume_input(1);
+            key = c;
+            break;
+        }
+
+        // Unknown escape sequences are dropped
+        if (key != CFW_NO_KEY)
+            return key;
+    }
+}
+
+// ------------------------------------------------------------------
+// |                   CFW internal platform API                    |
+// ------------------------------------------------------------------
+
+int _cfw_platform_get_char(void)
+{
+    // The console has to be up to date before halting
+    _cfw_platform_ansi_flush();
+    return read_key(-1);
+}
+
+int _cfw_platform_get_char_no_halt(void)
+{
+    return read_key(0);
+}
@@ -0,0 +1,87 @@
+#ifndef __cfw_ansi_internal_h__
+#define __cfw_ansi_internal_h__
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <termios.h>
+
+// Control Sequence Introducer
+#define _CFW_ANSI_CSI "\033["
+
+typedef struct __cfw_ansi_state __cfw_ansi_state;
+
+struct __cfw_ansi_state
+{
+    // Set while the console is in raw mode
+    cfw__bool       active;
+
+    // Terminal settings to restore when terminating, and the raw
+    // mode to go back to when the application is continued
+    struct termios  original_termios;
+    struct termios  raw_termios;
+
+    // Output of the current frame. Everything is collected here and
+    // written to the console in a single call on refresh.
+    char            *output;
+    size_t          output_size;
+    size_t          output_capacity;
+
+    // Optional escape sequences the console responded to when probed
+    struct
+    {
+        // REP - Repeat preceding character
+        cfw__bool   repeat;
+
+        // ECH - Erase Character, and erasing with the background
+        // color instead of the default one
+        cfw__bool   erase;
+
+        // SGR 22, 24, 27, 39 and 49, which turn off the attributes
+        // and the colors without resetting everything else
+        cfw__bool   attributes_off;
+
+        // Number of colors the console can display: 16, 256, or
+        // 16777216 for 24-bit colors
+        int         colors;
+    } capabilities;
+
+    // Position of the cursor in the console, or -1 when unknown
+    int             cursor_x;
+    int             cursor_y;
+
+    // Attributes currently set in the console, and the attributes the
+    // next text should be drawn with. The escape sequence setting the
+    // attributes is only sent when text is drawn with different ones.
+    uint32_t        fg_color;
+    uint32_t        bg_color;
+    int             attributes;
+    uint32_t        next_fg_color;
+    uint32_t        next_bg_color;
+    int             next_attributes;
+
+    // Bytes read from the console that haven't been decoded yet
+    unsigned char   input[32];
+    int             input_size;
+};
+
+extern __cfw_ansi_state __cfw_ansi;
+
+// Set by the signal handler when the application is continued after
+// being stopped, as the console may have been used by others since
+extern volatile sig_atomic_t __cfw_ansi_resumed;
+
+// ------------------------------------------------------------------
+// |                   CFW internal platform API                    |
+// ------------------------------------------------------------------
+
+void        _cfw_platform_ansi_write(const char *data, size_t size);
+void        _cfw_platform_ansi_write_str(const char *str);
+void        _cfw_platform_ansi_write_int(int value);
+cfw__bool   _cfw_platform_ansi_flush(void);
+
+#endif /* __cfw_ansi_internal_h__ */
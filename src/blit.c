@@ -0,0 +1,351 @@
+/**
+ * @file blit.c
+ * @author Nicolai Frigaard
+ * @brief Implementation of the image drawing API.
+ *
+ * Images are drawn two pixels to a cell, as upper half blocks with
+ * the upper pixel as the foreground color and the lower pixel as the
+ * background color. On consoles without 24-bit colors, the pixels are
+ * dithered to the colors of the console.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <string.h>
+
+// Ordered dithering offsets 16 channels at a time with SSE2, which is
+// always available on x86-64
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define _CFW_DITHER_SSE2
+#endif
+
+#include "internal.h"
+
+#define UPPER_HALF_BLOCK 0x2580
+
+// Bytes of the offsets of 16 pixels, after which the offsets of a row
+// repeat, and which is a whole number of vectors
+#define PATTERN_SIZE 48
+
+// How far apart the colors of the palettes are, roughly. Ordered
+// dithering offsets the pixels by up to half of it either way.
+#define SPREAD_256  48
+#define SPREAD_16   128
+
+// Order the pixels of every 4x4 block are turned up in as they get
+// brighter
+static const int bayer[4][4] =
+{
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+typedef struct pixel_converter pixel_converter;
+
+// Turns the rows of an image into cell colors
+struct pixel_converter
+{
+    // Number of colors of the console, and how the pixels are dithered
+    // to them
+    int             colors;
+    int             dither_mode;
+
+    // Row of pixels with the ordered dithering offsets added
+    uint8_t         *offset_pixels;
+
+    // Errors carried to the current and the next row, three channels
+    // per pixel with an extra pixel on both sides
+    int             *errors;
+    int             *next_errors;
+};
+
+uint32_t quantize(uint32_t rgb, int colors, cfw__bool foreground)
+{
+    if (colors == 256)
+        return _CFW_COLOR_256 | _cfw_color_to_256(rgb);
+
+    // Foregrounds keep the bright bit of the 16 colors, which is drawn
+    // as bold, until the style is built. Backgrounds only have the 8
+    // normal colors.
+    if (foreground)
+        return _CFW_COLOR_PALETTE | _cfw_color_to_16(rgb);
+
+    return _CFW_COLOR_PALETTE | _cfw_color_to_8(rgb);
+}
+
+uint32_t get_quantized_rgb(uint32_t color)
+{
+    if (_CFW_COLOR_KIND(color) == _CFW_COLOR_256)
+        return _cfw_color_from_256(_CFW_COLOR_VALUE(color));
+
+    return _cfw_color_from_16(_CFW_COLOR_VALUE(color));
+}
+
+uint32_t get_pixel(const uint8_t *pixel)
+{
+    return ((uint32_t)pixel[0] << 16) | ((uint32_t)pixel[1] << 8) | pixel[2];
+}
+
+void offset_pixels(const uint8_t *pixels, int count, int x, int y, int spread, uint8_t *out)
+{
+    // Every pixel is offset by its place in the Bayer matrix, so the
+    // two closest colors alternate in proportion to how close they
+    // are. The offsets are split into what is added and subtracted,
+    // as the channels saturate at both ends.
+    uint8_t add[PATTERN_SIZE], subtract[PATTERN_SIZE];
+    for (int i = 0; i < PATTERN_SIZE / 3; i++)
+    {
+        int offset = (2 * bayer[y & 3][(x + i) & 3] + 1) * spread / 32 - spread / 2;
+        memset(&add[i * 3], max(offset, 0), 3);
+        memset(&subtract[i * 3], max(-offset, 0), 3);
+    }
+
+    size_t size = (size_t)count * 3;
+    size_t i = 0;
+
+#if defined(_CFW_DITHER_SSE2)
+    __m128i add_vectors[3], subtract_vectors[3];
+    for (int j = 0; j < 3; j++)
+    {
+        add_vectors[j] = _mm_loadu_si128((const __m128i *)&add[j * 16]);
+        subtract_vectors[j] = _mm_loadu_si128((const __m128i *)&subtract[j * 16]);
+    }
+
+    for (; i + PATTERN_SIZE <= size; i += PATTERN_SIZE)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            __m128i vector = _mm_loadu_si128((const __m128i *)&pixels[i + j * 16]);
+            vector = _mm_adds_epu8(vector, add_vectors[j]);
+            vector = _mm_subs_epu8(vector, subtract_vectors[j]);
+            _mm_storeu_si128((__m128i *)&out[i + j * 16], vector);
+        }
+    }
+#endif
+
+    // Offset the channels that are left over
+    for (; i < size; i++)
+    {
+        int value = pixels[i] + add[i % PATTERN_SIZE] - subtract[i % PATTERN_SIZE];
+        out[i] = (uint8_t)min(max(value, 0), 255);
+    }
+}
+
+void diffuse_errors(const pixel_converter *converter, const uint8_t *pixels, int count,
+                    cfw__bool foreground, uint32_t *out)
+{
+    int *errors = converter->errors;
+    int *below = converter->next_errors;
+
+    // The errors are kept in sixteenths. The row below starts out
+    // without any.
+    memset(below, 0, ((size_t)count + 2) * 3 * sizeof(int));
+
+    for (int i = 0; i < count; i++)
+    {
+        int *error = &errors[(i + 1) * 3];
+        int *error_below = &below[(i + 1) * 3];
+
+        int value[3];
+        for (int c = 0; c < 3; c++)
+            value[c] = min(max(pixels[i * 3 + c] + error[c] / 16, 0), 255);
+
+        uint32_t color = quantize(((uint32_t)value[0] << 16) | (value[1] << 8) | value[2],
+                                  converter->colors, foreground);
+        uint32_t actual = get_quantized_rgb(color);
+
+        // Spread what the color is off by over the pixels that are
+        // yet to be converted, by the Floyd-Steinberg weights
+        for (int c = 0; c < 3; c++)
+        {
+            int difference = value[c] - (int)((actual >> (16 - c * 8)) & 0xFF);
+            error[c + 3]       += difference * 7;
+            error_below[c - 3] += difference * 3;
+            error_below[c]     += difference * 5;
+            error_below[c + 3] += difference;
+        }
+
+        out[i] = color;
+    }
+}
+
+void convert_row(pixel_converter *converter, const uint8_t *pixels, int count,
+                 int x, int y, cfw__bool foreground, uint32_t *out)
+{
+    // 24-bit colors are drawn as they are
+    if (converter->colors > 256)
+    {
+        for (int i = 0; i < count; i++)
+            out[i] = _CFW_COLOR_RGB | get_pixel(&pixels[i * 3]);
+        return;
+    }
+
+    switch (converter->dither_mode)
+    {
+    case CFW_DITHER_ORDERED:
+        offset_pixels(pixels, count, x, y,
+                      (converter->colors == 256) ? SPREAD_256 : SPREAD_16,
+                      converter->offset_pixels);
+        pixels = converter->offset_pixels;
+        break;
+
+    case CFW_DITHER_FLOYD_STEINBERG:
+        diffuse_errors(converter, pixels, count, foreground, out);
+        CFW_SWAP_POINTERS(converter->errors, converter->next_errors);
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+        out[i] = quantize(get_pixel(&pixels[i * 3]), converter->colors, foreground);
+}
+
+void put_image_row(int x, int y, const uint32_t *upper, const uint32_t *lower,
+                   int count, __cfw_cell *cells)
+{
+    __cfw_style previous = { 0 };
+    uint32_t style_id = _CFW_STYLE_DEFAULT;
+    int run_start = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        // The image doesn't cover the lower half of its last row when
+        // its height is odd
+        __cfw_style style;
+        style.fg = upper[i];
+        style.bg = (lower != NULL) ? lower[i] : __cfw.pen_style.bg;
+        style.attr = 0;
+
+        if (_CFW_COLOR_KIND(style.fg) == _CFW_COLOR_PALETTE && (style.fg & 8))
+        {
+            style.fg &= ~8;
+            style.attr = _CFW_ATTR_BOLD;
+        }
+
+        // Neighboring cells with the same colors share their style
+        if (i == 0 || style.fg != previous.fg || style.bg != previous.bg ||
+            style.attr != previous.attr)
+        {
+            // Interning a style may collect the styles no cell
+            // references, so the cells before are put first
+            if (i > run_start)
+                _cfw_framebuffer_put_cells(x + run_start, y, &cells[run_start], i - run_start);
+
+            style_id = _cfw_intern_style(&style);
+            previous = style;
+            run_start = i;
+        }
+
+        cells[i].glyph = UPPER_HALF_BLOCK;
+        cells[i].style = style_id;
+    }
+
+    if (count > run_start)
+        _cfw_framebuffer_put_cells(x + run_start, y, &cells[run_start], count - run_start);
+}
+
+// ------------------------------------------------------------------
+// |                         CFW PUBLIC API                         |
+// ------------------------------------------------------------------
+
+CFWAPI void cfw_dither_mode(int mode)
+{
+    CFW_REQUIRE_INIT();
+
+    // Check if the mode is not one of the permitted modes
+    if (mode < CFW_DITHER_NONE || mode > CFW_DITHER_FLOYD_STEINBERG)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "Mode 0x%x is not a valid dither mode.", mode);
+        return;
+    }
+
+    __cfw.dither_mode = mode;
+}
+
+CFWAPI void cfw_blit_rgb(int x, int y, const uint8_t *rgb, int width, int height, int stride)
+{
+    CFW_REQUIRE_INIT();
+    CFW_REQUIRE_FEATURE_ENABLED(CFW_COLORS);
+
+    // Check if the image is valid
+    if (width < 0 || height < 0)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "%dx%d is not a valid image size.", width, height);
+        return;
+    }
+    if (stride < width * 3)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "%d is not a valid stride for an image %d pixels wide.",
+                         stride, width);
+        return;
+    }
+    if (rgb == NULL && width > 0 && height > 0)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "The pixels of a %dx%d image can't be NULL.",
+                         width, height);
+        return;
+    }
+
+    const __cfw_region *region = &__cfw.regions[__cfw.region_depth];
+
+    // Translate the image to the console, and clip it to the visible
+    // part of the region. Every row of cells covers two rows of
+    // pixels.
+    x += region->offset_x;
+    y += region->offset_y;
+
+    int left   = max(x, region->clip_left);
+    int top    = max(y, region->clip_top);
+    int right  = min(x + width, region->clip_right);
+    int bottom = min(y + (height + 1) / 2, region->clip_bottom);
+
+    if (left >= right || top >= bottom)
+        return;
+
+    int count = right - left;
+    int first_column = left - x;
+
+    // The colors of both halves of a row of cells, the cells, the
+    // offset pixels and the errors share the scratch memory
+    size_t colors_size = (size_t)count * sizeof(uint32_t);
+    size_t cells_size  = (size_t)count * sizeof(__cfw_cell);
+    size_t errors_size = ((size_t)count + 2) * 3 * sizeof(int);
+    size_t pixels_size = (size_t)count * 3;
+
+    char *scratch = _cfw_get_scratch(cells_size + 2 * colors_size + 2 * errors_size + pixels_size);
+    if (scratch == NULL)
+        return;
+
+    __cfw_cell *cells = (__cfw_cell *)scratch;
+    uint32_t *upper = (uint32_t *)(scratch + cells_size);
+    uint32_t *lower = (uint32_t *)(scratch + cells_size + colors_size);
+
+    pixel_converter converter;
+    converter.colors = _cfw_platform_get_color_count();
+    converter.dither_mode = __cfw.dither_mode;
+    converter.errors = (int *)(scratch + cells_size + 2 * colors_size);
+    converter.next_errors = (int *)(scratch + cells_size + 2 * colors_size + errors_size);
+    converter.offset_pixels = (uint8_t *)(scratch + cells_size + 2 * colors_size + 2 * errors_size);
+
+    // Errors are diffused from the first visible row on
+    memset(converter.errors, 0, errors_size);
+
+    for (int row = top; row < bottom; row++)
+    {
+        int pixel_y = (row - y) * 2;
+        const uint8_t *pixels = &rgb[(size_t)pixel_y * stride + (size_t)first_column * 3];
+
+        convert_row(&converter, pixels, count, first_column, pixel_y, CFW_TRUE, upper);
+
+        if (pixel_y + 1 < height)
+        {
+            convert_row(&converter, pixels + stride, count, first_column, pixel_y + 1,
+                        CFW_FALSE, lower);
+            put_image_row(left, row, upper, lower, count, cells);
+        }
+        else
+            put_image_row(left, row, upper, NULL, count, cells);
+    }
+}
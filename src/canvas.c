@@ -0,0 +1,387 @@
+/**
+ * @file canvas.c
+ * @author Nicolai Frigaard
+ * @brief Implementation of the sub-cell canvas.
+ *
+ * In the braille and half-block canvas modes, geometry isn't drawn
+ * to cells, but to a plane of dots with one bit per dot. Every cell
+ * covers 2x4 dots in braille mode and 1x2 dots in half-block mode.
+ * When the console is refreshed, the cells with new dots are packed
+ * into the glyph showing their dots, and written to the back buffer.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+// Dots are split into the columns of the cells with a single
+// instruction when the compiler is allowed to use BMI2
+#if defined(__BMI2__)
+    #include <immintrin.h>
+    #define _CFW_PACK_BMI2
+#endif
+
+#include "internal.h"
+
+// Glyphs of the half-block patterns, with the top dot in bit 0 and
+// the bottom dot in bit 1
+static const uint32_t half_block_glyphs[4] = { ' ', 0x2580, 0x2584, 0x2588 };
+
+// First braille pattern. The dots of a pattern are its low 8 bits.
+#define BRAILLE_BLANK 0x2800
+
+size_t get_row_words(int width)
+{
+    // Rows always start a new word
+    return ((size_t)width + 63) / 64;
+}
+
+void set_bits(uint64_t *words, int first, int last)
+{
+    uint64_t first_mask = ~0ULL << (first & 63);
+    uint64_t last_mask  = ~0ULL >> (63 - (last & 63));
+
+    int first_word = first >> 6;
+    int last_word  = last >> 6;
+
+    if (first_word == last_word)
+    {
+        words[first_word] |= first_mask & last_mask;
+        return;
+    }
+
+    words[first_word] |= first_mask;
+    for (int i = first_word + 1; i < last_word; i++)
+        words[i] = ~0ULL;
+    words[last_word] |= last_mask;
+}
+
+uint64_t get_even_bits(uint64_t x)
+{
+    // Gather every other bit into the low 32 bits
+#if defined(_CFW_PACK_BMI2)
+    return _pext_u64(x, 0x5555555555555555ULL);
+#else
+    x &= 0x5555555555555555ULL;
+    x = (x | (x >> 1))  & 0x3333333333333333ULL;
+    x = (x | (x >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x >> 4))  & 0x00FF00FF00FF00FFULL;
+    x = (x | (x >> 8))  & 0x0000FFFF0000FFFFULL;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFFULL;
+    return x;
+#endif
+}
+
+uint64_t transpose_bits(uint64_t x)
+{
+    // Transpose the 8x8 matrix with a row in every byte, by swapping
+    // 1x1, 2x2 and then 4x4 blocks across the diagonal. This is
+    // transpose8 from Hacker's Delight.
+    uint64_t t;
+    t = (x ^ (x >> 7))  & 0x00AA00AA00AA00AAULL; x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL; x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL; x ^= t ^ (t << 28);
+    return x;
+}
+
+void put_patterns(int x, int y, uint64_t patterns, unsigned changed)
+{
+    __cfw_canvas *canvas = &__cfw.canvas;
+    const uint32_t *styles = &canvas->styles[(size_t)y * canvas->width];
+
+    // Only the cells with new dots are written, so what was drawn
+    // over the rest of the cells is left alone
+    for (int i = 0; i < 8 && x + i < canvas->width; i++)
+    {
+        if (!(changed & (1u << i)))
+            continue;
+
+        unsigned pattern = (patterns >> (i * 8)) & 0xFF;
+        uint32_t glyph = (canvas->mode == CFW_BRAILLE) ?
+            BRAILLE_BLANK | pattern : half_block_glyphs[pattern & 3];
+
+        _cfw_framebuffer_put_cell(x + i, y, glyph, styles[x + i]);
+    }
+}
+
+void pack_braille_row(int y)
+{
+    __cfw_canvas *canvas = &__cfw.canvas;
+    const uint64_t *changed = &canvas->changed[(size_t)y * canvas->changed_words];
+    const uint64_t *dots = &canvas->dots[(size_t)y * 4 * canvas->row_words];
+
+    // Every word of dots covers 32 cells
+    for (size_t word = 0; word < canvas->row_words; word++)
+    {
+        uint32_t cells_changed = (uint32_t)(changed[word / 2] >> ((word % 2) * 32));
+        if (cells_changed == 0)
+            continue;
+
+        // Split the four rows of dots into the left and right column
+        // of the cells, with one bit per cell
+        uint64_t left[4], right[4];
+        for (int row = 0; row < 4; row++)
+        {
+            uint64_t bits = dots[row * canvas->row_words + word];
+            left[row]  = get_even_bits(bits);
+            right[row] = get_even_bits(bits >> 1);
+        }
+
+        for (int chunk = 0; chunk < 4; chunk++)
+        {
+            unsigned chunk_changed = (cells_changed >> (chunk * 8)) & 0xFF;
+            if (chunk_changed == 0)
+                continue;
+
+            // Put the columns of 8 cells in the order of the dots of
+            // the braille patterns, one byte per dot, and transpose
+            // them into one byte per cell
+            int shift = chunk * 8;
+            uint64_t planes =
+                ((left[0]  >> shift) & 0xFF)       |
+                ((left[1]  >> shift) & 0xFF) << 8  |
+                ((left[2]  >> shift) & 0xFF) << 16 |
+                ((right[0] >> shift) & 0xFF) << 24 |
+                ((right[1] >> shift) & 0xFF) << 32 |
+                ((right[2] >> shift) & 0xFF) << 40 |
+                ((left[3]  >> shift) & 0xFF) << 48 |
+                ((right[3] >> shift) & 0xFF) << 56;
+
+            put_patterns((int)word * 32 + shift, y, transpose_bits(planes), chunk_changed);
+        }
+    }
+}
+
+void pack_half_block_row(int y)
+{
+    __cfw_canvas *canvas = &__cfw.canvas;
+    const uint64_t *changed = &canvas->changed[(size_t)y * canvas->changed_words];
+    const uint64_t *top = &canvas->dots[(size_t)y * 2 * canvas->row_words];
+    const uint64_t *bottom = top + canvas->row_words;
+
+    // Every word of dots covers 64 cells
+    for (size_t word = 0; word < canvas->row_words; word++)
+    {
+        if (changed[word] == 0)
+            continue;
+
+        for (int chunk = 0; chunk < 8; chunk++)
+        {
+            int shift = chunk * 8;
+            unsigned chunk_changed = (changed[word] >> shift) & 0xFF;
+            if (chunk_changed == 0)
+                continue;
+
+            uint64_t planes = ((top[word] >> shift) & 0xFF) |
+                              ((bottom[word] >> shift) & 0xFF) << 8;
+
+            put_patterns((int)word * 64 + shift, y, transpose_bits(planes), chunk_changed);
+        }
+    }
+}
+
+// ------------------------------------------------------------------
+// |                        CFW internal API                        |
+// ------------------------------------------------------------------
+
+cfw__bool _cfw_canvas_resize(int width, int height)
+{
+    __cfw_canvas *canvas = &__cfw.canvas;
+
+    if (width < 0)  width = 0;
+    if (height < 0) height = 0;
+
+    size_t row_words = get_row_words(width * canvas->scale_x);
+    size_t changed_words = get_row_words(width);
+    size_t dot_rows = (size_t)height * canvas->scale_y;
+    size_t cells = (size_t)width * (size_t)height;
+
+    // One extra entry is allocated so a zero-sized console still gets
+    // valid pointers
+    uint64_t *dots    = calloc(dot_rows * row_words + 1, sizeof(uint64_t));
+    uint64_t *changed = calloc((size_t)height * changed_words + 1, sizeof(uint64_t));
+    uint32_t *styles  = malloc((cells + 1) * sizeof(uint32_t));
+
+    if (dots == NULL || changed == NULL || styles == NULL)
+    {
+        free(dots);
+        free(changed);
+        free(styles);
+
+        _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+        return CFW_FALSE;
+    }
+
+    for (size_t i = 0; i < cells; i++)
+        styles[i] = _CFW_STYLE_DEFAULT;
+
+    // Keep the dots that are still visible, so dots drawn later join
+    // them in the cells they were already packed into
+    if (canvas->dots != NULL)
+    {
+        size_t copy_words = min(row_words, canvas->row_words);
+        size_t copy_rows  = min(dot_rows, (size_t)canvas->height * canvas->scale_y);
+        int copy_width    = min(width, canvas->width);
+        int copy_height   = min(height, canvas->height);
+
+        // Dots right of the new width are dropped
+        int last_bits = (width * canvas->scale_x) % 64;
+        uint64_t last_mask = last_bits ? ~0ULL >> (64 - last_bits) : ~0ULL;
+
+        for (size_t y = 0; y < copy_rows && row_words > 0; y++)
+        {
+            memcpy(&dots[y * row_words], &canvas->dots[y * canvas->row_words],
+                   copy_words * sizeof(uint64_t));
+            dots[y * row_words + row_words - 1] &= last_mask;
+        }
+
+        for (int y = 0; y < copy_height; y++)
+        {
+            memcpy(&styles[(size_t)y * width], &canvas->styles[(size_t)y * canvas->width],
+                   copy_width * sizeof(uint32_t));
+        }
+    }
+
+    _cfw_canvas_free();
+
+    canvas->width = width;
+    canvas->height = height;
+    canvas->dots = dots;
+    canvas->row_words = row_words;
+    canvas->changed = changed;
+    canvas->changed_words = changed_words;
+    canvas->styles = styles;
+
+    return CFW_TRUE;
+}
+
+void _cfw_canvas_free(void)
+{
+    __cfw_canvas *canvas = &__cfw.canvas;
+
+    free(canvas->dots);
+    free(canvas->changed);
+    free(canvas->styles);
+
+    canvas->width = 0;
+    canvas->height = 0;
+    canvas->dots = NULL;
+    canvas->row_words = 0;
+    canvas->changed = NULL;
+    canvas->changed_words = 0;
+    canvas->styles = NULL;
+    canvas->dirty = CFW_FALSE;
+}
+
+void _cfw_canvas_clear(void)
+{
+    __cfw_canvas *canvas = &__cfw.canvas;
+
+    if (canvas->dots == NULL)
+        return;
+
+    // The styles of cells without dots are never used, so they can
+    // keep referencing their styles until they are drawn again
+    memset(canvas->dots, 0, (size_t)canvas->height * canvas->scale_y *
+                            canvas->row_words * sizeof(uint64_t));
+    memset(canvas->changed, 0, (size_t)canvas->height * canvas->changed_words *
+                               sizeof(uint64_t));
+    canvas->dirty = CFW_FALSE;
+}
+
+const __cfw_region *_cfw_canvas_get_region(void)
+{
+    __cfw_canvas *canvas = &__cfw.canvas;
+    const __cfw_region *region = &__cfw.regions[__cfw.region_depth];
+
+    // Scale the current region to dots. It's only done once per
+    // primitive row, so it isn't worth caching.
+    canvas->region.offset_x    = region->offset_x * canvas->scale_x;
+    canvas->region.offset_y    = region->offset_y * canvas->scale_y;
+    canvas->region.clip_left   = region->clip_left * canvas->scale_x;
+    canvas->region.clip_top    = region->clip_top * canvas->scale_y;
+    canvas->region.clip_right  = region->clip_right * canvas->scale_x;
+    canvas->region.clip_bottom = region->clip_bottom * canvas->scale_y;
+
+    return &canvas->region;
+}
+
+// The dots are already clipped to the current region, which never
+// reaches outside the canvas
+
+void _cfw_canvas_put_span(int x, int y, int length)
+{
+    __cfw_canvas *canvas = &__cfw.canvas;
+
+    set_bits(&canvas->dots[(size_t)y * canvas->row_words], x, x + length - 1);
+
+    // The cells take the current colors
+    int cell_y = y / canvas->scale_y;
+    int first  = x / canvas->scale_x;
+    int last   = (x + length - 1) / canvas->scale_x;
+
+    uint32_t *styles = &canvas->styles[(size_t)cell_y * canvas->width];
+    for (int i = first; i <= last; i++)
+        styles[i] = __cfw.pen.style;
+
+    set_bits(&canvas->changed[(size_t)cell_y * canvas->changed_words], first, last);
+    canvas->dirty = CFW_TRUE;
+}
+
+void _cfw_canvas_pack(void)
+{
+    __cfw_canvas *canvas = &__cfw.canvas;
+
+    // No dots have been drawn since the last time
+    if (!canvas->dirty)
+        return;
+
+    for (int y = 0; y < canvas->height; y++)
+    {
+        if (canvas->mode == CFW_BRAILLE)
+            pack_braille_row(y);
+        else
+            pack_half_block_row(y);
+    }
+
+    memset(canvas->changed, 0, (size_t)canvas->height * canvas->changed_words *
+                               sizeof(uint64_t));
+    canvas->dirty = CFW_FALSE;
+}
+
+// ------------------------------------------------------------------
+// |                         CFW PUBLIC API                         |
+// ------------------------------------------------------------------
+
+CFWAPI void cfw_canvas_mode(int mode)
+{
+    CFW_REQUIRE_INIT();
+
+    __cfw_canvas *canvas = &__cfw.canvas;
+
+    // Check if the mode is not one of the permitted modes
+    if (mode < CFW_CELLS || mode > CFW_HALF_BLOCKS)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "Mode 0x%x is not a valid canvas mode.", mode);
+        return;
+    }
+
+    if (mode == canvas->mode)
+        return;
+
+    // The dots drawn in the previous mode stay in their cells, and
+    // the new mode starts out without any
+    _cfw_canvas_pack();
+    _cfw_canvas_free();
+
+    canvas->mode = CFW_CELLS;
+    if (mode == CFW_CELLS)
+        return;
+
+    canvas->scale_x = (mode == CFW_BRAILLE) ? 2 : 1;
+    canvas->scale_y = (mode == CFW_BRAILLE) ? 4 : 2;
+
+    if (_cfw_canvas_resize(__cfw.width, __cfw.height))
+        canvas->mode = mode;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file color.c
+ * @author Nicolai Frigaard
+ * @brief Implementation of the color quantization.
+ *
+ * Consoles that can't display 24-bit colors get the closest color of
+ * their palette instead. The closest colors are looked up in tables
+ * indexed by the five most significant bits of each channel, which
+ * are generated by tools/color_tables.py.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include "internal.h"
+#include "color_tables.h"
+
+// The default xterm palette of the 16 basic colors, in CFW order
+static const unsigned char basic_palette[16][3] =
+{
+    {   0,   0,   0 }, {   0,   0, 238 }, {   0, 205,   0 }, {   0, 205, 205 },
+    { 205,   0,   0 }, { 205,   0, 205 }, { 205, 205,   0 }, { 229, 229, 229 },
+    { 127, 127, 127 }, {  92,  92, 255 }, {   0, 255,   0 }, {   0, 255, 255 },
+    { 255,   0,   0 }, { 255,   0, 255 }, { 255, 255,   0 }, { 255, 255, 255 }
+};
+
+void get_256_color(int index, int *r, int *g, int *b)
+{
+    if (index < 16)
+    {
+        // The basic colors, numbered like ANSI, which swaps red and
+        // blue compared to CFW
+        const unsigned char *color = basic_palette[(index & 10) | (index & 1) << 2 | (index & 4) >> 2];
+        *r = color[0];
+        *g = color[1];
+        *b = color[2];
+    }
+    else if (index < 232)
+    {
+        // The 6x6x6 color cube
+        static const int levels[6] = { 0, 95, 135, 175, 215, 255 };
+        index -= 16;
+        *r = levels[index / 36];
+        *g = levels[(index / 6) % 6];
+        *b = levels[index % 6];
+    }
+    else
+    {
+        // The gray ramp
+        *r = *g = *b = 8 + (index - 232) * 10;
+    }
+}
+
+int get_table_index(uint32_t color)
+{
+    return ((color >> 9) & 0x7C00) | ((color >> 6) & 0x03E0) | ((color >> 3) & 0x001F);
+}
+
+// ------------------------------------------------------------------
+// |                        CFW internal API                        |
+// ------------------------------------------------------------------
+
+int _cfw_color_to_256(uint32_t color)
+{
+    return color_table_256[get_table_index(color)];
+}
+
+int _cfw_color_to_16(uint32_t color)
+{
+    return color_table_16[get_table_index(color)] & 15;
+}
+
+int _cfw_color_to_8(uint32_t color)
+{
+    return color_table_16[get_table_index(color)] >> 4;
+}
+
+uint32_t _cfw_color_from_256(int index)
+{
+    int r, g, b;
+    get_256_color(index, &r, &g, &b);
+    return (r << 16) | (g << 8) | b;
+}
+
+uint32_t _cfw_color_from_16(int index)
+{
+    const unsigned char *color = basic_palette[index & 15];
+    return (color[0] << 16) | (color[1] << 8) | color[2];
+}
@@ -0,0 +1,4110 @@
+// Generated by tools/color_tables.py. Do not edit.
+
+#define COLOR_TABLE_SIZE 32768
+
+// Closest color in the xterm 256 color palette
+static const unsigned char color_table_256[COLOR_TABLE_SIZE] =
+{
+     16, 232, 232, 232, 233, 233, 233,  17,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    232, 232, 232, 233, 233, 233, 234,  17,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    232, 233, 233, 233, 233, 234, 234, 234,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 233, 233, 234, 234, 234, 235,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 234, 234, 234, 234, 235, 235, 235,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 234, 234, 234, 234, 235, 235, 235, 236, 236, 236,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 234, 235, 235, 235, 235, 236, 236, 236,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22, 235, 235, 235, 235, 236, 236, 236,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22, 236, 236, 236, 236,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22, 236,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+    232, 232, 232, 233, 233, 233, 233,  17,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    232, 232, 233, 233, 233, 233, 234,  17,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    232, 233, 233, 233, 234, 234, 234, 234,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 233, 234, 234, 234, 234, 235, 235,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 234, 234, 234, 235, 235, 235, 235, 236,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 234, 234, 235, 235, 235, 235, 236, 236, 236,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 234, 235, 235, 235, 236, 236, 236, 236, 237,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22, 235, 235, 235, 235, 236, 236, 236, 236, 237,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22, 235, 236, 236, 236, 236, 237,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22, 236, 237,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+    232, 232, 232, 233, 233, 233, 234,  17,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    232, 233, 233, 233, 233, 234, 234, 234,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 233, 233, 234, 234, 234, 235,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 234, 234, 234, 234, 235, 235, 235,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 234, 234, 234, 234, 235, 235, 235, 236, 236, 236,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 234, 235, 235, 235, 235, 236, 236, 236, 236, 237,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 235, 235, 235, 235, 236, 236, 236, 236, 237, 237,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22, 236, 236, 236, 236, 237, 237, 237,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22, 236, 236, 237, 237,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22, 237, 237,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+    232, 232, 233, 233, 233, 233, 234,  17,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    232, 233, 233, 233, 234, 234, 234, 234,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 233, 234, 234, 234, 234, 235, 235,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 234, 234, 234, 235, 235, 235, 235, 236,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 234, 234, 235, 235, 235, 235, 236, 236, 236,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 234, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 235, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+    235, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 238, 238,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22, 236, 236, 236, 236, 237, 237, 237, 237, 238,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22, 236, 236, 237, 237, 237, 237, 238,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22, 237, 237, 238, 238,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22, 237, 238,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+    232, 233, 233, 233, 233, 234, 234, 234,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 233, 233, 234, 234, 234, 235,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 234, 234, 234, 234, 235, 235, 235,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 234, 234, 234, 234, 235, 235, 235, 236, 236, 236,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 234, 235, 235, 235, 235, 236, 236, 236, 236, 237,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 235, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 238, 238,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+    235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22, 235, 236, 236, 236, 236, 237, 237, 237, 238, 238, 238, 238,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22, 236, 237, 237, 237, 237, 238, 238, 238, 238,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22, 237, 237, 237, 238, 238, 238,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22, 238, 238, 238, 238,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22, 238, 238, 238,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+    232, 233, 233, 233, 234, 234, 234, 234,  17,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 233, 234, 234, 234, 234, 235, 235,  17,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    233, 233, 234, 234, 234, 235, 235, 235, 235, 236,  17,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 234, 234, 235, 235, 235, 235, 236, 236, 236,  17,  17,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 234, 234, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237,  17,  18,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    234, 235, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238,  18,
+     18,  18,  18,  19,  19,  19,  19,  19,  20,  20,  20,  20,  20,  21,  21,  21,
+    235, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 238, 238, 238, 238, 239,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+    235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 238, 239,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 239, 239, 239,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22, 236, 236, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22, 237, 238, 238, 238, 239, 239, 239, 239,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22, 238, 238, 239, 239, 239,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     22,  22,  22,  22,  22, 238, 239, 239, 239,  23,  23,  23,  23,  23,  24,  24,
+     24,  24,  24,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  27,  27,  27,
+     28,  28,  28,  28,  28,  28, 239,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     28,  28,  28,  28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  30,  30,
+     30,  30,  30,  31,  31,  31,  31,  31,  32,  32,  32,  32,  32,  33,  33,  33,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     34,  34,  34,  34,  34,  34,  35,  35,  35,  35,  35,  35,  35,  35,  36,  36,
+     36,  36,  36,  37,  37,  37,  37,  37,  38,  38,  38,  38,  38,  39,  39,  39,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     40,  40,  40,  40,  40,  40,  41,  41,  41,  41,  41,  41,  41,  41,  42,  42,
+     42,  42,  42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  44,  45,  45,  45,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+     46,  46,  46,  46,  46,  46,  47,  47,  47,  47,  47,  47,  47,  47,  48,  48,
+     48,  48,  48,  49,  49,  49,  49,  49,  50,  50,  50,  50,  50,  51,  51,  51,
+    233, 233, 233, 233, 234, 234, 234, 235,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    233, 233, 234, 234, 234, 234, 235, 235, 235,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    233, 234, 234, 234, 234, 235, 235, 235, 236, 236,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    234, 234, 234, 235, 235, 235, 235, 236, 236, 236, 236,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    234, 234, 235, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    234, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 239, 239,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+    235, 235, 236, 236, 236, 236, 237, 237, 237, 238, 238, 238, 238, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58, 236, 237, 237, 237, 237, 238, 238, 238, 239, 239, 239, 239, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58, 237, 237, 238, 238, 238, 238, 239, 239, 239, 239, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 238, 238, 239, 239, 239, 240, 240, 240,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 239, 239, 239, 239, 240, 240, 240,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 239, 239, 240, 240, 240,  59,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     64,  64,  64,  64,  64, 239, 239, 240, 240, 240,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     52,  52,  52, 234, 234, 234, 234,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52, 234, 234, 234, 235, 235, 235,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    234, 234, 234, 234, 235, 235, 235, 235, 236,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    234, 234, 234, 235, 235, 235, 236, 236, 236, 236, 237,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    234, 235, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 237,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    235, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 238, 238, 238, 238,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 238, 239, 239,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+    235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 239, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58, 236, 236, 236, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 237, 238, 238, 238, 239, 239, 239, 239, 240, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 238, 239, 239, 239, 239, 240, 240, 240,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 238, 239, 239, 239, 240, 240, 240, 240,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 239, 240, 240, 240,  59,  59, 241,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     64,  64,  64,  64,  64,  64, 239, 240, 240,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     52,  52,  52,  52,  52, 234, 235,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52, 234, 234, 235, 235,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52, 234, 235, 235, 235, 235, 236, 236,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52, 234, 235, 235, 235, 235, 236, 236, 236, 236,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    234, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 237,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    235, 235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 239,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    235, 235, 236, 236, 236, 236, 237, 237, 237, 238, 238, 238, 238, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58, 236, 237, 237, 237, 237, 238, 238, 238, 239, 239, 239, 239, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58, 237, 237, 238, 238, 238, 238, 239, 239, 239, 239, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 238, 238, 239, 239, 239, 240, 240, 240,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 239, 239, 239, 239, 240, 240, 240,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 239, 239, 240, 240, 240,  59,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 240, 240, 240, 240,  59,  59, 241, 241,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     64,  64,  64,  64,  64,  64, 240, 240,  65,  65,  65,  65,  65, 241, 242,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52, 235, 235,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52, 235, 235, 235, 236, 236,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52, 235, 235, 235, 236, 236, 236, 236,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52, 235, 235, 235, 236, 236, 236, 236, 237, 237, 237,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    235, 235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 238, 239,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    235, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 239, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58, 236, 236, 236, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 237, 238, 238, 238, 239, 239, 239, 239, 240, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 238, 239, 239, 239, 239, 240, 240, 240,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 238, 239, 239, 239, 240, 240, 240, 240,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 239, 240, 240, 240,  59,  59, 241,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 240, 240, 240,  59,  59, 241, 241, 242,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     64,  64,  64,  64,  64,  64, 240, 240,  65,  65,  65,  65,  65, 242, 242,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52, 235, 235, 236,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52, 235, 236, 236, 236, 236, 237,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52, 235, 236, 236, 236, 236, 237, 237, 237, 237,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+    235, 235, 236, 236, 236, 236, 237, 237, 237, 238, 238, 238, 238, 239, 239,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     58, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58, 236, 237, 237, 237, 237, 238, 238, 238, 239, 239, 239, 239, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58, 237, 237, 238, 238, 238, 238, 239, 239, 239, 239, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 238, 238, 239, 239, 239, 240, 240, 240,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 239, 239, 239, 239, 240, 240, 240,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 239, 239, 240, 240, 240,  59,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 240, 240, 240, 240,  59,  59, 241, 241,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58,  58, 240, 240, 240,  59,  59, 241, 241, 241, 242,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     64,  64,  64,  64,  64,  64, 240,  65,  65,  65,  65,  65, 242, 242, 242,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52, 236, 236,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52, 236, 236, 236, 236,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52, 236, 236, 236, 237, 237, 237, 237,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52, 236, 236, 236, 236, 237, 237, 237, 237, 238, 238, 238, 239, 239,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     58, 236, 236, 236, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239, 239,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 237, 238, 238, 238, 239, 239, 239, 239, 240, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 238, 239, 239, 239, 239, 240, 240, 240,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 238, 239, 239, 239, 240, 240, 240, 240,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 239, 240, 240, 240,  59,  59, 241,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 240, 240, 240,  59,  59, 241, 241, 242,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58,  58, 240, 240, 240,  59,  59, 241, 241, 242, 242,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65, 241, 242, 242, 242, 243,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65, 243,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52, 236, 236,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52, 236, 236, 236, 237, 237, 237,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52, 236, 236, 237, 237, 237, 237, 238, 238, 238, 238, 239, 239,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     58,  58, 236, 237, 237, 237, 237, 238, 238, 238, 239, 239, 239, 239, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58, 237, 237, 238, 238, 238, 238, 239, 239, 239, 239, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 238, 238, 239, 239, 239, 240, 240, 240,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 239, 239, 239, 239, 240, 240, 240,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 239, 239, 240, 240, 240,  59,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 240, 240, 240, 240,  59,  59, 241, 241,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58,  58, 240, 240, 240,  59,  59, 241, 241, 241, 242,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58,  58, 240, 240,  59,  59, 241, 241, 242, 242, 242, 242,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65, 242, 242, 242, 242, 243,
+    243,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65, 243,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52,  52,  53,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52,  52, 236, 237,  53,  53,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52,  52, 236, 237, 237, 237, 237,  53,  53,  53,  53,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     52,  52,  52, 236, 237, 237, 237, 238, 238, 238, 238, 239, 239,  53,  54,  54,
+     54,  54,  54,  55,  55,  55,  55,  55,  56,  56,  56,  56,  56,  57,  57,  57,
+     58,  58,  58, 237, 237, 237, 238, 238, 238, 238, 239, 239, 239, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 237, 238, 238, 238, 239, 239, 239, 239, 240, 240, 240,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58, 238, 238, 238, 239, 239, 239, 239, 240, 240, 240,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 238, 239, 239, 239, 240, 240, 240, 240,  59,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 239, 240, 240, 240,  59,  59, 241,  60,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58, 239, 239, 240, 240, 240,  59,  59, 241, 241, 242,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58,  58, 240, 240, 240,  59,  59, 241, 241, 242, 242,  60,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     58,  58,  58,  58,  58,  58, 240,  59,  59, 241, 241, 241, 242, 242, 242, 243,
+     60,  60,  60,  61,  61,  61,  61,  61,  62,  62,  62,  62,  62,  63,  63,  63,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65, 242, 242, 242, 242, 243, 243,
+    243, 243,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65, 243, 243, 243,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65, 243,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  65,  65,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  69,  69,  69,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     70,  70,  70,  70,  70,  70,  71,  71,  71,  71,  71,  71,  71,  71,  72,  72,
+     72,  72,  72,  73,  73,  73,  73,  73,  74,  74,  74,  74,  74,  75,  75,  75,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     76,  76,  76,  76,  76,  76,  77,  77,  77,  77,  77,  77,  77,  77,  78,  78,
+     78,  78,  78,  79,  79,  79,  79,  79,  80,  80,  80,  80,  80,  81,  81,  81,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     82,  82,  82,  82,  82,  82,  83,  83,  83,  83,  83,  83,  83,  83,  84,  84,
+     84,  84,  84,  85,  85,  85,  85,  85,  86,  86,  86,  86,  86,  87,  87,  87,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88, 237, 237, 237,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88, 237, 237, 237, 237, 238, 238, 238, 239, 239,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     94,  94,  94, 237, 237, 238, 238, 238, 238, 239, 239, 239, 239, 240, 240,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94, 238, 238, 238, 238, 239, 239, 239, 240, 240, 240,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94, 238, 239, 239, 239, 239, 240, 240, 240,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94, 239, 239, 239, 239, 240, 240, 240,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94, 239, 239, 240, 240, 240,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94, 240, 240, 240,  95,  95,  95, 241, 241, 242,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94, 240, 240,  95,  95,  95, 241, 242, 242, 242, 242,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95, 241, 242, 242, 242, 242, 243,
+    243,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 242, 242, 242, 243, 243, 243,
+    243, 244, 244, 244, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 243, 243, 243, 243,
+    244, 244, 244, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 243, 244, 244,
+    244, 244, 102, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 244,
+    102, 102, 245, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 102,
+    102, 245, 245, 246, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 246, 246, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88, 237,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88, 237, 237, 238, 238, 238, 238,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     94,  94,  94,  94, 237, 238, 238, 238, 239, 239, 239, 239,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94, 238, 238, 239, 239, 239,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94, 238, 239, 239, 239,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94, 239, 239,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95, 242, 242,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95, 242, 242, 243, 243,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 242, 242, 243, 243, 243,
+    244, 244, 244, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 243, 243, 244,
+    244, 244, 102, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 244,
+    244, 102, 102, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 244,
+    102, 102, 245, 245, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 102, 102,
+    245, 245, 245, 246, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 246, 246, 246, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88, 238, 238, 238,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     94,  94,  94,  94,  94, 238, 238, 238, 239,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94, 238, 239, 239,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94, 239,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95, 243, 243, 243,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 243, 243, 243, 243,
+    244, 244, 244, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 243, 244, 244,
+    244, 244, 102, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 244,
+    102, 102, 245, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 102,
+    102, 245, 245, 246, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 102, 102,
+    245, 245, 246, 246, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    245, 246, 246, 246, 247, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 247, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     94,  94,  94,  94,  94, 238, 238,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95, 243,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 243, 243, 244,
+    244, 244, 102, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 244,
+    244, 102, 102, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 244,
+    102, 102, 245, 245, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 102, 102,
+    245, 245, 245, 246, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 102, 245,
+    245, 246, 246, 246, 246, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    246, 246, 246, 246, 247, 247, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 247, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  90,  90,
+     90,  90,  90,  91,  91,  91,  91,  91,  92,  92,  92,  92,  92,  93,  93,  93,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+     94,  94,  94,  94,  94,  94,  95,  95,  95,  95,  95,  95,  95,  95,  96,  96,
+     96,  96,  96,  97,  97,  97,  97,  97,  98,  98,  98,  98,  98,  99,  99,  99,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 243, 244, 244,
+    244, 244, 102, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 244,
+    102, 102, 245, 103, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 244, 102,
+    102, 245, 245, 246, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 102, 102,
+    245, 245, 246, 246, 103, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101, 245, 245,
+    245, 246, 246, 246, 247, 103, 103, 103, 104, 104, 104, 104, 104, 105, 105, 105,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 246,
+    246, 246, 246, 247, 247, 247, 247, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 247, 247, 247, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 247, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107, 108, 108,
+    108, 108, 108, 109, 109, 109, 109, 109, 110, 110, 110, 110, 110, 111, 111, 111,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113, 114, 114,
+    114, 114, 114, 115, 115, 115, 115, 115, 116, 116, 116, 116, 116, 117, 117, 117,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119, 120, 120,
+    120, 120, 120, 121, 121, 121, 121, 121, 122, 122, 122, 122, 122, 123, 123, 123,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 244, 244,
+    244, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 244, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 245, 245, 246, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    245, 246, 246, 246, 246, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 245,
+    246, 246, 246, 246, 247, 247, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 246,
+    246, 246, 247, 247, 247, 247, 248, 248, 248, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 247, 247, 247, 247, 248, 248, 248, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 247, 248, 248, 248, 248, 145, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 248, 145, 145, 249, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 145, 145, 249, 249, 250, 146, 146, 146, 146, 147, 147, 147,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 250, 250, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 246, 246, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 246, 246, 247, 247, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    246, 246, 247, 247, 247, 248, 248, 248, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 247, 247, 248, 248, 248, 145, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 248, 248, 145, 145, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 248, 145, 145, 249, 249, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 145, 145, 249, 249, 249, 250, 146, 146, 146, 146, 147, 147, 147,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 250, 250, 250, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 247, 247, 247, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 247, 247, 247, 247, 248, 248, 248, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 247, 248, 248, 248, 248, 145, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 248, 145, 145, 249, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 145, 145, 249, 249, 250, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 145, 145, 249, 249, 250, 250, 146, 146, 146, 146, 147, 147, 147,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 249, 250, 250, 250, 251, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 251, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 247, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 247, 247, 248, 248, 248, 145, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 248, 248, 145, 145, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 248, 145, 145, 249, 249, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 145, 145, 249, 249, 249, 250, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 145, 249, 249, 250, 250, 250, 250, 146, 146, 146, 147, 147, 147,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 250, 250, 250, 250, 251, 251, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 251, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125, 126, 126,
+    126, 126, 126, 127, 127, 127, 127, 127, 128, 128, 128, 128, 128, 129, 129, 129,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132,
+    132, 132, 132, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 135, 135, 135,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138,
+    138, 138, 138, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141, 141, 141,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 247, 248, 248, 248, 248, 145, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 248, 145, 145, 249, 146, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 248, 145, 145, 249, 249, 250, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 145, 145, 249, 249, 250, 250, 146, 146, 146, 146, 147, 147, 147,
+    142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 144, 144,
+    144, 144, 144, 249, 249, 249, 250, 250, 250, 251, 146, 146, 146, 147, 147, 147,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 250, 250, 250, 250, 251, 251, 251, 251, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 251, 251, 251, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 251, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150,
+    150, 150, 150, 151, 151, 151, 151, 151, 152, 152, 152, 152, 152, 153, 153, 153,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    154, 154, 154, 154, 154, 154, 155, 155, 155, 155, 155, 155, 155, 155, 156, 156,
+    156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158, 158, 159, 159, 159,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 248, 248, 248, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 248, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 249, 249, 250, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 249, 250, 250, 250, 250, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 249, 250, 250, 250, 250, 251, 251, 182, 182, 183, 183, 183,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 250, 250, 250, 251, 251, 251, 251, 252, 252, 252, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 251, 251, 251, 251, 252, 252, 252, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 251, 252, 252, 252, 252, 188, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 252, 188, 188, 253, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 188, 188, 253, 253, 254, 189, 189,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 254, 254, 195, 195,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 195, 195, 195,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 195, 195, 195,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 250, 250, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 250, 250, 251, 251, 182, 182, 182, 183, 183, 183,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 250, 250, 251, 251, 251, 252, 252, 252, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 251, 251, 252, 252, 252, 188, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 252, 252, 188, 188, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 252, 188, 188, 253, 253, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 188, 188, 253, 253, 253, 254, 189, 189,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 254, 254, 254, 195, 195,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 195, 195, 195,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 195, 195, 195,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 251, 251, 251, 182, 182, 182, 183, 183, 183,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 251, 251, 251, 251, 252, 252, 252, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 251, 252, 252, 252, 252, 188, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 252, 188, 188, 253, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 188, 188, 253, 253, 254, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 188, 188, 253, 253, 254, 254, 189, 189,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 253, 254, 254, 254, 255, 195,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 255, 195, 195,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 195, 195, 195,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 251, 182, 182, 182, 182, 183, 183, 183,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 251, 251, 252, 252, 252, 188, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 252, 252, 188, 188, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 252, 188, 188, 253, 253, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 188, 188, 253, 253, 253, 254, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 188, 253, 253, 254, 254, 254, 254, 189,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 254, 254, 254, 254, 255, 255,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 255, 195, 195,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 195, 195, 195,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    160, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 161, 161, 161, 162, 162,
+    162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165, 165, 165,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171, 171,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 173, 173, 174, 174,
+    174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177, 177, 177,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179, 179, 179, 179, 180, 180,
+    180, 180, 180, 181, 181, 181, 181, 181, 182, 182, 182, 182, 182, 183, 183, 183,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 251, 252, 252, 252, 252, 188, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 252, 188, 188, 253, 189, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 252, 188, 188, 253, 253, 254, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 188, 188, 253, 253, 254, 254, 189, 189,
+    184, 184, 184, 184, 184, 184, 185, 185, 185, 185, 185, 185, 185, 185, 186, 186,
+    186, 186, 186, 187, 187, 187, 187, 187, 253, 253, 253, 254, 254, 254, 255, 189,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 254, 254, 254, 254, 255, 255, 255,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 255, 255, 255, 195,
+    190, 190, 190, 190, 190, 190, 191, 191, 191, 191, 191, 191, 191, 191, 192, 192,
+    192, 192, 192, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 255, 195, 195,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 252, 252, 252, 224, 224, 225, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 252, 224, 224, 224, 224, 225, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 253, 253, 254, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 253, 254, 254, 254, 254, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 253, 254, 254, 254, 254, 255, 255,
+    226, 226, 226, 226, 226, 226, 227, 227, 227, 227, 227, 227, 227, 227, 228, 228,
+    228, 228, 228, 229, 229, 229, 229, 229, 230, 254, 254, 254, 255, 255, 255, 255,
+    226, 226, 226, 226, 226, 226, 227, 227, 227, 227, 227, 227, 227, 227, 228, 228,
+    228, 228, 228, 229, 229, 229, 229, 229, 230, 230, 230, 255, 255, 255, 255, 255,
+    226, 226, 226, 226, 226, 226, 227, 227, 227, 227, 227, 227, 227, 227, 228, 228,
+    228, 228, 228, 229, 229, 229, 229, 229, 230, 230, 230, 230, 255, 255, 255, 231,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 224, 224, 225, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 224, 224, 225, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 224, 224, 225, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 224, 254, 254, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 254, 254, 255, 255, 225,
+    226, 226, 226, 226, 226, 226, 227, 227, 227, 227, 227, 227, 227, 227, 228, 228,
+    228, 228, 228, 229, 229, 229, 229, 229, 230, 230, 254, 254, 255, 255, 255, 255,
+    226, 226, 226, 226, 226, 226, 227, 227, 227, 227, 227, 227, 227, 227, 228, 228,
+    228, 228, 228, 229, 229, 229, 229, 229, 230, 230, 230, 230, 255, 255, 255, 231,
+    226, 226, 226, 226, 226, 226, 227, 227, 227, 227, 227, 227, 227, 227, 228, 228,
+    228, 228, 228, 229, 229, 229, 229, 229, 230, 230, 230, 230, 230, 255, 231, 231,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 197, 198, 198,
+    198, 198, 198, 199, 199, 199, 199, 199, 200, 200, 200, 200, 200, 201, 201, 201,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    202, 202, 202, 202, 202, 202, 203, 203, 203, 203, 203, 203, 203, 203, 204, 204,
+    204, 204, 204, 205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 207, 207, 207,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209, 209, 210, 210,
+    210, 210, 210, 211, 211, 211, 211, 211, 212, 212, 212, 212, 212, 213, 213, 213,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    214, 214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 219, 219, 219,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 224, 224, 225, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 224, 224, 225, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 224, 224, 225, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 224, 224, 225, 225, 225,
+    220, 220, 220, 220, 220, 220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222,
+    222, 222, 222, 223, 223, 223, 223, 223, 224, 224, 224, 224, 255, 255, 255, 225,
+    226, 226, 226, 226, 226, 226, 227, 227, 227, 227, 227, 227, 227, 227, 228, 228,
+    228, 228, 228, 229, 229, 229, 229, 229, 230, 230, 230, 255, 255, 255, 255, 255,
+    226, 226, 226, 226, 226, 226, 227, 227, 227, 227, 227, 227, 227, 227, 228, 228,
+    228, 228, 228, 229, 229, 229, 229, 229, 230, 230, 230, 230, 255, 255, 255, 231,
+    226, 226, 226, 226, 226, 226, 227, 227, 227, 227, 227, 227, 227, 227, 228, 228,
+    228, 228, 228, 229, 229, 229, 229, 229, 230, 230, 230, 230, 230, 231, 231, 231,
+};
+
+// Closest of the 16 basic colors in the low nibble, and of the 8
+// normal ones in the high nibble
+static const unsigned char color_table_16[COLOR_TABLE_SIZE] =
+{
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,  24,
+     24,  24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  17,  17,  17,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  57,  57,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  17,  17,  17,  17,  17,  17,  17,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  57,  57,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,  24,
+     24,  24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  17,  17,  17,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  57,  57,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  17,  17,  17,  17,  17,  17,  17,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  51,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,  24,
+     24,  24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  17,  17,  17,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  51,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  17,  17,  17,  17,  17,  17,  17,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,  24,
+     24,  24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  17,  17,  17,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  51,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  17,  17,  17,  17,  17,  17,  17,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,  24,
+     24,  24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  17,  17,  17,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  57,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  51,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,  24,
+     17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  24,
+     24,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  24,
+     24,  24,  24,  17,  17,  17,  17,  17,  17,  17,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  24,
+     24,  24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,
+     56,  24,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  85,  85,
+     85,  85,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  85,  85,
+     85,  85,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,  88,  88,
+     85,  85,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  88,  88,
+     88,  88,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,  88,  88,
+     88,  88,  24,  24,  17,  17,  17,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  24,  24,  24,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  51,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  85,  85,
+     85,  85,  85,  85,  85,  85,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  85,  85,
+     85,  85,  85,  85,  85,  85,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,  88,  85,
+     85,  85,  85,  85,  85,  85,  17,  17,  17,  17,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,  88,  88,
+     88,  85,  85,  85,  85,  85,  17,  17,  17,  17,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  88,  88,
+     88,  88,  88,  85,  85,  89,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  88,  88,  89,  89,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  88,  88,  88,  89,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  88,  88,  88,  89,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  88,  88,  88,  88,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  88,  88,  88,  88,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  88,  88,  88,  88,  25,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,
+     88,  88,  88,  88,  88,  88,  24,  25,  25,  25,  25,  25,  25,  25,  25,  25,
+      8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  25,  25,  25,  25,  25,  25,  25,
+     40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,  57,
+     40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  57,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  17,  17,  17,  17,  17,  17,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,  88,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  17,  17,  17,  17,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  89,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,  88,  88,  88,
+     88,  88,  88,  85,  85,  85,  85,  89,  89,  89,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,  88,  88,  88,
+     88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,  88,  88,  88,
+     88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,  88,
+     88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  25,  25,  25,  25,  25,  25,
+      0,   0,   0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  25,  25,  25,  25,  25,  25,
+      0,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  25,  25,  25,  25,  25,  25,
+      8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  25,  25,  25,  25,  25,  25,
+      8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,   8,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  25,  25,  25,  25,  25,  25,
+     40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+     34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  57,  57,  57,
+     34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  40,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  40,  56,  56,  56,
+     56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+     34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  34,  40,  40,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  40,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  51,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,
+     42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  42,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,  59,  59,  59,  59,  59,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  17,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  17,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  25,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  88,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,  25,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  88,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,  89,  89,  25,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  89,  89,  89,  89,  89,  89,  89,  89,  89,  25,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,  25,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  25,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  25,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  25,
+     68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  25,
+     72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  25,
+     72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  25,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+    102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  51,  51,  57,  57,  57,  57,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  57,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104,  56,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104,  56,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104,  56,  56,  56,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59, 123, 123,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104,  56,  56,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59, 123, 123, 123,
+    106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106,  56,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  51,  59,  59, 123, 123, 123, 123,
+    106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106,  58,  51,  51,
+     51,  51,  51,  51,  51,  51,  51,  51,  51,  59, 123, 123, 123, 123, 123, 123,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  85,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,  57,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+    102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  57,  57,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  56,  56,  51,  51,  51,  51,  51,  51, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104,  56,  56,
+     56,  56,  56,  56,  51,  51,  51,  51,  51,  51,  51, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104,  56,  56,
+     56,  56,  56,  51,  51,  51,  51,  51,  51, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104,  56,  56,
+     56,  56,  51,  51,  51,  51,  51,  51, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104,  56,  56,
+     51,  51,  51,  51,  51,  51,  51, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104,  56,  51,
+     51,  51,  51,  51,  51, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 123,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,  51,  51,
+     51,  51,  51,  51, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 123, 123,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  85,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+    102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57,  57, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  57, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56,  56, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56, 119, 119, 119, 119, 119, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56, 120, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104,  56,
+     56,  56,  56, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104,  56,
+     56,  56, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104,  56,
+    120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  88,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  85,  85,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57,  57,  57, 121, 121, 121,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  57,  57, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56,  56, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56,  56,  56, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56,  56, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56,  56, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56,  56,  56, 120, 120, 120, 120, 120, 120, 119, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56,  56, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104,  56,
+     56,  56, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104,  56,
+     56, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  85,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89, 121,
+    102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+     56,  56,  56,  56,  56,  56, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+     56,  56,  56,  56,  56, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+     56,  56,  56,  56, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+     56,  56, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+     56, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  85,  85,  85,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89, 121, 121,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+     88,  88, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  88,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89, 121, 121,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+     88, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  88,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  85,  85,  85,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89, 121, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  88,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  85,  85,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89, 121, 121, 121, 121,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  88,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  85,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  85,  85,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88, 121, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  88,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  89,  89,  89,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  85,  85,  89,  89,  89,  89,  89,
+     68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  89,  89,  89,  89,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127, 127,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  93,  93,  93,
+     68,  68,  68,  68,  68,  72,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  85,  85,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88,  88, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127, 127,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  72,  88,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  72,  72,  88,  88,  88,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  72,  72,  72,  88,  88,  88,
+     88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  85,  85,  85,  93,  93,  93,  93,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  89,  89,  89,  89,  89,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88,  88, 120, 120, 120, 120, 121, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127, 127,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127, 127, 127,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  72,  72,  72,  88,  88,  88,
+     88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  72,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  93,  93,  93,  93,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  85,  85,  93,  93,  93,  93,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88, 120, 120, 120, 120, 120, 119, 121, 121, 121, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127, 127,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 126, 126, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127, 127, 127, 127,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  85,  85,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  72,  88,  88,  85,
+     85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  72,  72,  88,  88,  88,
+     88,  85,  85,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  76,  76,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  85,  85,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  76,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  85,  85,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+     76,  76,  76,  76,  76,  76,  76,  72,  72,  72,  72,  72,  72,  88,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  85,  85,  85,  85,  93,  93,  93,  93,  93,
+    102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,  88,  88,
+     88,  88,  88,  88,  88,  88,  88,  88,  88,  88,  85,  93,  93,  93,  93,  93,
+    102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,  88,
+     88,  88,  88,  88,  88,  88, 120, 120, 120, 120, 119, 119, 119, 119, 119, 121,
+    102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 104, 104,
+    120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 104, 120,
+    120, 120, 120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 104, 120,
+    120, 120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 104, 120,
+    120, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 104, 120,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127, 127,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 119, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127, 127, 127,
+    110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 126, 126, 119,
+    119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 119, 127, 127, 127, 127,
+};
@@ -17,260 +17,698 @@
 
 #include "internal.h"
 
-int translate_xy_to_bounds(int *x, int *y, int length)
+void compose_region(__cfw_region *region, const __cfw_region *parent)
 {
-    int max_x, max_y;
-    int offset_x = 0, offset_y = 0;
-    max_x = __cfw.width;
-    max_y = __cfw.height;
+    // Regions are positioned relative to their parent...
+    region->offset_x = parent->offset_x + region->x;
+    region->offset_y = parent->offset_y + region->y;
+
+    // ...and only the part inside the parent is visible
+    region->clip_left   = max(parent->clip_left, region->offset_x);
+    region->clip_top    = max(parent->clip_top, region->offset_y);
+    region->clip_right  = min(parent->clip_right, region->offset_x + region->width);
+    region->clip_bottom = min(parent->clip_bottom, region->offset_y + region->height);
+}
+
+cfw__bool translate_xy_to_bounds(int *x, int *y)
+{
+    const __cfw_region *region = &__cfw.regions[__cfw.region_depth];
+
+    // Shift XY to the console
+    *x += region->offset_x;
+    *y += region->offset_y;
+
+    // Check if the position is visible
+    return *x >= region->clip_left && *x < region->clip_right &&
+           *y >= region->clip_top  && *y < region->clip_bottom;
+}
+
+const __cfw_region *get_raster_region(void)
+{
+    // Geometry is drawn in dots in the sub-cell canvas modes, and in
+    // cells otherwise
+    if (__cfw.canvas.mode != CFW_CELLS)
+        return _cfw_canvas_get_region();
+
+    return &__cfw.regions[__cfw.region_depth];
+}
+
+void put_point(int x, int y, uint32_t glyph)
+{
+    // The canvas only has dots, so the glyph isn't used there
+    if (__cfw.canvas.mode != CFW_CELLS)
+        _cfw_canvas_put_span(x, y, 1);
+    else
+        _cfw_framebuffer_put_char(x, y, glyph);
+}
+
+void put_span(int x, int y, uint32_t glyph, int length)
+{
+    if (__cfw.canvas.mode != CFW_CELLS)
+        _cfw_canvas_put_span(x, y, length);
+    else
+        _cfw_framebuffer_put_span(x, y, glyph, length);
+}
+
+cfw__bool is_box_visible(int left, int top, int right, int bottom)
+{
+    const __cfw_region *region = get_raster_region();
+
+    // Check if the box, given inclusively in region coordinates,
+    // overlaps the visible part of the region
+    return left   + region->offset_x <  region->clip_right &&
+           right  + region->offset_x >= region->clip_left  &&
+           top    + region->offset_y <  region->clip_bottom &&
+           bottom + region->offset_y >= region->clip_top;
+}
+
+uint32_t get_glyph(char c)
+{
+    // Single characters can only be ASCII, as everything else takes
+    // more than one byte in UTF-8
+    return (c >= ' ' && c <= '~') ? (uint32_t)c : _CFW_REPLACEMENT_CHARACTER;
+}
+
+void plot(int x, int y, uint32_t glyph)
+{
+    const __cfw_region *region = get_raster_region();
+
+    // Plot a cell in region coordinates, if it's visible
+    x += region->offset_x;
+    y += region->offset_y;
+
+    if (x >= region->clip_left && x < region->clip_right &&
+        y >= region->clip_top  && y < region->clip_bottom)
+        put_point(x, y, glyph);
+}
+
+void draw_span(int x1, int x2, int y, uint32_t glyph)
+{
+    const __cfw_region *region = get_raster_region();
+
+    // Translate the span to the console
+    x1 += region->offset_x;
+    x2 += region->offset_x;
+    y  += region->offset_y;
+
+    if (y < region->clip_top || y >= region->clip_bottom)
+        return;
+
+    // Clamp the span to the visible part of the row
+    x1 = max(x1, region->clip_left);
+    x2 = min(x2, region->clip_right - 1);
+
+    if (x1 <= x2)
+        put_span(x1, y, glyph, x2 - x1 + 1);
+}
 
-    // If a region is currently set...
-    if (__cfw.region_head != NULL)
+void update_pen(void)
+{
+    // Cells reference their style by id
+    __cfw.pen.style = _cfw_intern_style(&__cfw.pen_style);
+}
+
+void set_pen_foreground(int color)
+{
+    // The bold flag of the color is stored as an attribute of the
+    // cells
+    __cfw.pen_style.fg = _CFW_COLOR_PALETTE | (color & 7);
+    __cfw.pen_style.attr = (color & 8) ? _CFW_ATTR_BOLD : 0;
+}
+
+void set_pen_background(int color)
+{
+    __cfw.pen_style.bg = _CFW_COLOR_PALETTE | (color & 7);
+}
+
+// Attributed runs
+
+cfw__bool check_run(const cfw__attr_run *run)
+{
+    if (run->attrs & ~(CFW_ATTR_BOLD | CFW_ATTR_UNDERLINE | CFW_ATTR_REVERSE | CFW_ATTR_RGB))
     {
-        // ...translate the position in the bounds
+        _cfw_input_error(CFW_INVALID_VALUE, "0x%x is not a valid set of attributes.", run->attrs);
+        return CFW_FALSE;
+    }
 
-        // Get the bound data of the currently active bounds
-        {
-            __cfw_region **current = &__cfw.region_head;
+    if (run->fg == CFW_CURRENT_COLOR && run->bg == CFW_CURRENT_COLOR)
+        return CFW_TRUE;
 
-            while (*current != NULL)
-            {
-                offset_x += (*current)->x;
-                offset_y += (*current)->y;
-                max_x = min(max_x, (*current)->width);
-                max_y = min(max_y, (*current)->height);
+    if (!(__cfw.enabled_features & CFW_COLORS))
+    {
+        _cfw_input_error(CFW_NOT_ENABLED, NULL);
+        return CFW_FALSE;
+    }
 
-                current = &(*current)->next;
-            }
-        }
+    int max_fg = (run->attrs & CFW_ATTR_RGB) ? 0xFFFFFF : CFW_BOLD_WHITE;
+    int max_bg = (run->attrs & CFW_ATTR_RGB) ? 0xFFFFFF : CFW_WHITE;
 
-        // Shift XY
-        *x += offset_x;
-        *y += offset_y;
+    if (run->fg < CFW_CURRENT_COLOR || run->fg > max_fg)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "%d is not a valid foreground color.", run->fg);
+        return CFW_FALSE;
+    }
+    if (run->bg < CFW_CURRENT_COLOR || run->bg > max_bg)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "%d is not a valid background color.", run->bg);
+        return CFW_FALSE;
+    }
+
+    return CFW_TRUE;
+}
 
-        // Check if the Y overflows the bound
-        if (*y > max_y + offset_y)
-            // Return a ridiculous overlow value
-            return 0xFFFFFF;
+void get_run_style(const cfw__attr_run *run, __cfw_style *style)
+{
+    *style = __cfw.pen_style;
+
+    // The bold flag of a color the run doesn't replace is kept
+    int attr = run->attrs & (CFW_ATTR_BOLD | CFW_ATTR_UNDERLINE | CFW_ATTR_REVERSE);
+    if (run->fg == CFW_CURRENT_COLOR)
+        attr |= style->attr & _CFW_ATTR_BOLD;
+
+    if (run->attrs & CFW_ATTR_RGB)
+    {
+        if (run->fg != CFW_CURRENT_COLOR)
+            style->fg = _CFW_COLOR_RGB | run->fg;
+        if (run->bg != CFW_CURRENT_COLOR)
+            style->bg = _CFW_COLOR_RGB | run->bg;
+    }
+    else
+    {
+        if (run->fg != CFW_CURRENT_COLOR)
+        {
+            style->fg = _CFW_COLOR_PALETTE | (run->fg & 7);
+            if (run->fg & 8)
+                attr |= _CFW_ATTR_BOLD;
+        }
+        if (run->bg != CFW_CURRENT_COLOR)
+            style->bg = _CFW_COLOR_PALETTE | (run->bg & 7);
     }
 
-    // Return the count of characters overflow the bound
-    return max(0, *x + length - (max_x + offset_x));
+    style->attr = attr;
 }
 
 // Polygon draw calls
 
-void draw_line(int x1, int y1, int x2, int y2, char c)
+void draw_points(const int *xy, size_t count, uint32_t glyph)
 {
-    CFW_REQUIRE_INIT();
+    const __cfw_region *region = get_raster_region();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Translate every point with the same region
+        int x = xy[i * 2] + region->offset_x;
+        int y = xy[i * 2 + 1] + region->offset_y;
+
+        if (x >= region->clip_left && x < region->clip_right &&
+            y >= region->clip_top  && y < region->clip_bottom)
+            put_point(x, y, glyph);
+    }
+}
+
+long long floor_div(long long numerator, long long denominator)
+{
+    // Integer division rounding towards negative infinity, for a
+    // positive denominator
+    long long quotient = numerator / denominator;
+    if (numerator % denominator < 0)
+        quotient--;
+    return quotient;
+}
+
+void draw_line(int x1, int y1, int x2, int y2, uint32_t glyph, cfw__bool skip_first)
+{
+    const __cfw_region *region = get_raster_region();
+
+    // Skip lines that don't cross the region at all
+    if (!is_box_visible(min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2)))
+        return;
+
+    // Translate the line to the console
+    x1 += region->offset_x;
+    y1 += region->offset_y;
+    x2 += region->offset_x;
+    y2 += region->offset_y;
 
     // Get the distance between the two points
     int dx = abs(x2 - x1);
     int dy = abs(y2 - y1);
 
-    // Set the initial grid location of the line
-    int x = x1;
-    int y = y1;
-
-    // The count of tiles the line intersects
-    int tile_count = 1 + dx + dy;
-
     // The value the x and y should increment with after a tile has
     // been visited
     int x_increment = (x2 > x1) ? 1 : -1;
     int y_increment = (y2 > y1) ? 1 : -1;
 
+    // The line is traversed in steps along each axis, where step i
+    // on the horizontal axis is the tile at x1 + i * x_increment.
+    // Find the steps that are inside the region.
+    int first_i = (x_increment > 0) ? region->clip_left - x1 : x1 - (region->clip_right - 1);
+    int last_i  = (x_increment > 0) ? region->clip_right - 1 - x1 : x1 - region->clip_left;
+    int first_j = (y_increment > 0) ? region->clip_top - y1 : y1 - (region->clip_bottom - 1);
+    int last_j  = (y_increment > 0) ? region->clip_bottom - 1 - y1 : y1 - region->clip_top;
+
+    first_i = max(first_i, 0);
+    first_j = max(first_j, 0);
+    last_i  = min(last_i, dx);
+    last_j  = min(last_j, dy);
+
+    // The line passes through tile (i, j) when it enters column i
+    // at y = (i - 1/2) * dy / dx, so the first tile of column i is
+    // at j = floor(((2i - 1) * dy + dx) / 2dx), and the first tile of
+    // row j the other way around. The line is monotonic, so the
+    // first tile inside the region is the first tile of its first
+    // column, unless that tile is above the region.
+    int i = first_i;
+    int j = (i > 0) ? (int)floor_div((2LL * i - 1) * dy + dx, 2LL * dx) : 0;
+    if (j < first_j)
+    {
+        j = first_j;
+        i = (j > 0) ? (int)floor_div((2LL * j - 1) * dx + dy, 2LL * dy) : 0;
+    }
+
     // The difference between the advancement value of the 
-    // advancement on the horizontal and vertical axises
-    int advance_axis = dx - dy;
-    
+    // advancement on the horizontal and vertical axises, at the
+    // first tile
+    int advance_axis = (int)((dx - dy) + 2LL * j * dx - 2LL * i * dy);
+
     // For the math to equal out, the distance must be doubled
     dx *= 2;
     dy *= 2;
 
-    // Traverse line
-    for (; tile_count > 0; --tile_count)
+    // Traverse line, until it leaves the region
+    while (i <= last_i && j <= last_j)
     {
-        // Draw the line character to the tile position
-        cfw_draw_char(x, y, c);
+        // Draw the line character to the tile position. The first
+        // tile is skipped when it was already drawn as the end of the
+        // line before it.
+        if (!skip_first || i != 0 || j != 0)
+            put_point(x1 + i * x_increment, y1 + j * y_increment, glyph);
 
         // Check what axis should be advanced next
         if (advance_axis == 0)
         {
             // The line passes through both the X and Y axis at the
             // same time
-            x += x_increment;
-            y += y_increment;
+            i++;
+            j++;
             advance_axis += dx - dy;
-            --tile_count;
         }
         else if (advance_axis > 0)
         {
             // Advance on the x axis
-            x += x_increment;
+            i++;
             advance_axis -= dy;
         }
         else
         {
             // Advance on the y axis
-            y += y_increment;
+            j++;
             advance_axis += dx;
         }
     }
 }
 
-void draw_triangle_lines(int x1, int y1,
-                         int x2, int y2,
-                         int x3, int y3, char c)
+void clip_edge_span(int ax, int ay, int bx, int by, int y, int *left, int *right)
 {
-    cfw_draw_line(x1, y1, x2, y2, c);
-    cfw_draw_line(x2, y2, x3, y3, c);
-    cfw_draw_line(x3, y3, x1, y1, c);
+    // Cells are inside the edge when the edge function
+    //   E(x, y) = (bx - ax) * (y - ay) - (by - ay) * (x - ax)
+    // is positive. Cells exactly on the edge are only inside for top
+    // and left edges, so triangles sharing an edge never draw the
+    // same cell twice.
+    long long dx = bx - ax;
+    long long dy = by - ay;
+    int bias = (dy < 0 || (dy == 0 && dx > 0)) ? 0 : 1;
+
+    // Solve E(x, y) >= bias for x
+    long long k = bias - dx * (y - ay);
+
+    if (dy < 0)
+        *left = (int)max(*left, ax - floor_div(-k, -dy));
+    else if (dy > 0)
+        *right = (int)min(*right, ax + floor_div(-k, dy));
+    else if (k > 0)
+        *right = *left - 1; // The row is entirely outside of the edge
 }
 
-void draw_bottom_triangle_fill(int x1, int y1,
-                               int x2, int y2,
-                               int x3, int y3, char c)
+void draw_triangle_fill(int x1, int y1,
+                        int x2, int y2,
+                        int x3, int y3, uint32_t glyph)
 {
-    float invslope1 = (x2 - x1) / (y2 - y1);
-    float invslope2 = (x3 - x1) / (y3 - y1);
+    const __cfw_region *region = get_raster_region();
+
+    // Translate the triangle to the console
+    x1 += region->offset_x; y1 += region->offset_y;
+    x2 += region->offset_x; y2 += region->offset_y;
+    x3 += region->offset_x; y3 += region->offset_y;
+
+    // Wind the points so the inside of every edge is to its right,
+    // in console coordinates. Flat triangles cover no cells.
+    long long area = (long long)(x2 - x1) * (y3 - y1) - (long long)(y2 - y1) * (x3 - x1);
+    if (area == 0)
+        return;
+    if (area < 0)
+    {
+        CFW_SWAP_VALUES(x2, x3);
+        CFW_SWAP_VALUES(y2, y3);
+    }
+
+    // Only the rows inside the region are rasterized
+    int top    = max(min(y1, min(y2, y3)), region->clip_top);
+    int bottom = min(max(y1, max(y2, y3)), region->clip_bottom - 1);
 
-    float curx1 = x1;
-    float curx2 = x1;
+    for (int y = top; y <= bottom; y++)
+    {
+        // Narrow the visible row down to the cells inside all three
+        // edges, and fill them in one go
+        int left  = region->clip_left;
+        int right = region->clip_right - 1;
+
+        clip_edge_span(x1, y1, x2, y2, y, &left, &right);
+        clip_edge_span(x2, y2, x3, y3, y, &left, &right);
+        clip_edge_span(x3, y3, x1, y1, y, &left, &right);
+
+        if (left <= right)
+            put_span(left, y, glyph, right - left + 1);
+    }
+}
 
-    for (int scanline_y = y1; scanline_y <= y2; scanline_y++)
+cfw__bool is_convex(const int *xy, size_t count)
+{
+    // Convex polygons turn the same way at every point
+    int turns = 0;
+
+    for (size_t i = 0; i < count; i++)
     {
-        cfw_draw_line((int)curx1, scanline_y, (int)curx2, scanline_y, c);
-        curx1 += invslope1;
-        curx2 += invslope2;
+        const int *a = &xy[i * 2];
+        const int *b = &xy[((i + 1) % count) * 2];
+        const int *c = &xy[((i + 2) % count) * 2];
+
+        long long cross = (long long)(b[0] - a[0]) * (c[1] - b[1]) -
+                          (long long)(b[1] - a[1]) * (c[0] - b[0]);
+        if (cross > 0)
+            turns |= 1;
+        else if (cross < 0)
+            turns |= 2;
     }
+
+    return turns != 3;
 }
 
-void draw_top_triangle_fill(int x1, int y1,
-                            int x2, int y2,
-                            int x3, int y3, char c)
+int compare_edges(const void *a, const void *b)
 {
-    float invslope1 = (x3 - x1) / (y3 - y1);
-    float invslope2 = (x3 - x2) / (y3 - y2);
+    const __cfw_edge *edge_a = a;
+    const __cfw_edge *edge_b = b;
 
-    float curx1 = x3;
-    float curx2 = x3;
+    return (edge_a->top > edge_b->top) - (edge_a->top < edge_b->top);
+}
 
-    for (int scanline_y = y3; scanline_y > y1; scanline_y--)
+long long get_edge_left(const __cfw_edge *edge)
+{
+    // First cell at or right of where the edge crosses the row
+    return edge->x + (edge->remainder > 0);
+}
+
+cfw__bool add_edge(__cfw_edge *edge, int ax, int ay, int bx, int by)
+{
+    const __cfw_region *region = get_raster_region();
+
+    // Edges are stored going down
+    edge->winding = (by > ay) ? 1 : -1;
+    if (by < ay)
     {
-        cfw_draw_line((int)curx1, scanline_y, (int)curx2, scanline_y, c);
-        curx1 -= invslope1;
-        curx2 -= invslope2;
+        CFW_SWAP_VALUES(ax, bx);
+        CFW_SWAP_VALUES(ay, by);
     }
+
+    // An edge crosses the rows from its top point up to its bottom
+    // point, so horizontal edges cross none. Rows outside of the
+    // region are left out.
+    edge->top = max(ay, region->clip_top);
+    edge->bottom = min(by, region->clip_bottom);
+    if (edge->top >= edge->bottom)
+        return CFW_FALSE;
+
+    long long dx = (long long)bx - ax;
+    long long dy = (long long)by - ay;
+
+    // Find where the edge crosses its first row
+    long long offset = (edge->top - ay) * dx;
+    long long whole = floor_div(offset, dy);
+    edge->x = ax + whole;
+    edge->remainder = offset - whole * dy;
+
+    edge->step = floor_div(dx, dy);
+    edge->step_remainder = dx - edge->step * dy;
+    edge->dy = dy;
+
+    return CFW_TRUE;
 }
 
-void draw_triangle_fill(int x1, int y1,
-                        int x2, int y2,
-                        int x3, int y3, char c)
+void fill_row(__cfw_edge **active, size_t count, int y, uint32_t glyph)
+{
+    const __cfw_region *region = get_raster_region();
+
+    // Cells from where the polygon is entered up to where it's left
+    // are inside, and filled as one span
+    int winding = 0;
+    long long start = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int previous = winding;
+        winding += (__cfw.fill_rule == CFW_EVEN_ODD) ? 1 : active[i]->winding;
+
+        cfw__bool was_inside = (__cfw.fill_rule == CFW_EVEN_ODD) ? (previous & 1) : previous != 0;
+        cfw__bool is_inside  = (__cfw.fill_rule == CFW_EVEN_ODD) ? (winding & 1) : winding != 0;
+
+        if (!was_inside && is_inside)
+            start = get_edge_left(active[i]);
+        else if (was_inside && !is_inside)
+        {
+            long long left  = max(start, region->clip_left);
+            long long right = min(get_edge_left(active[i]) - 1, region->clip_right - 1);
+
+            if (left <= right)
+                put_span((int)left, y, glyph, (int)(right - left + 1));
+        }
+    }
+}
+
+void fill_polygon(const int *xy, size_t count, uint32_t glyph)
 {
-    // Sort the points by accending y coordinate
-    if (y1 > y2) { CFW_SWAP_VALUES(x1, x2); CFW_SWAP_VALUES(y1, y2); }
-    if (y1 > y3) { CFW_SWAP_VALUES(x1, x3); CFW_SWAP_VALUES(y1, y3); }
-    if (y2 > y3) { CFW_SWAP_VALUES(x2, x3); CFW_SWAP_VALUES(y2, y3); }
+    const __cfw_region *region = get_raster_region();
+
+    // Polygons without area cover no cells
+    if (count < 3)
+        return;
 
-    // Check if the triangle is either a top triangle or a bottom
-    // triangle
-    if (y2 == y3)
+    // The edges are followed by the list of the edges crossing the
+    // current row
+    size_t entry_size = sizeof(__cfw_edge) + sizeof(__cfw_edge *);
+    if (count > SIZE_MAX / entry_size)
     {
-        // The triangle is a bottom triangle
-        draw_bottom_triangle_fill(x1, y1, x2, y2, x3, y3, c);
+        _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+        return;
     }
-    else if (y1 == y2)
+
+    __cfw_edge *edges = _cfw_get_scratch(count * entry_size);
+    if (edges == NULL)
+        return;
+    __cfw_edge **active = (__cfw_edge **)&edges[count];
+
+    // Build the edge table in console coordinates, sorted by the row
+    // the edges start at
+    size_t edge_count = 0;
+    for (size_t i = 0; i < count; i++)
     {
-        // The triangle is a top triangle
-        draw_top_triangle_fill(x1, y1, x2, y2, x3, y3, c);
+        const int *a = &xy[i * 2];
+        const int *b = &xy[((i + 1) % count) * 2];
+
+        if (add_edge(&edges[edge_count],
+                     a[0] + region->offset_x, a[1] + region->offset_y,
+                     b[0] + region->offset_x, b[1] + region->offset_y))
+            edge_count++;
     }
-    else
+
+    if (edge_count == 0)
+        return;
+
+    qsort(edges, edge_count, sizeof(__cfw_edge), compare_edges);
+
+    size_t next = 0;
+    size_t active_count = 0;
+    int y = edges[0].top;
+
+    while (next < edge_count || active_count > 0)
     {
-        // The triangle is neither, so split it into both types
-        int x4 = (int)(x1 + ((float)(y2 - y1) / (float)(y3 - y1)) * (x3 - x1));
-        int y4 = y2;
-        draw_bottom_triangle_fill(x1, y1, x2, y2, x4, y4, c);
-        draw_top_triangle_fill(x2, y2, x4, y4, x3, y3, c);
+        // Activate the edges starting at this row
+        while (next < edge_count && edges[next].top == y)
+            active[active_count++] = &edges[next++];
+
+        // Sort the crossings from left to right. They keep most of
+        // their order from the previous row, which suits an
+        // insertion sort.
+        for (size_t i = 1; i < active_count; i++)
+        {
+            __cfw_edge *edge = active[i];
+            long long left = get_edge_left(edge);
+
+            size_t j = i;
+            while (j > 0 && get_edge_left(active[j - 1]) > left)
+            {
+                active[j] = active[j - 1];
+                j--;
+            }
+            active[j] = edge;
+        }
+
+        fill_row(active, active_count, y, glyph);
+
+        // Move the edges to the next row, and drop the ones that end
+        y++;
+        size_t kept = 0;
+        for (size_t i = 0; i < active_count; i++)
+        {
+            __cfw_edge *edge = active[i];
+            if (edge->bottom <= y)
+                continue;
+
+            edge->x += edge->step;
+            edge->remainder += edge->step_remainder;
+            if (edge->remainder >= edge->dy)
+            {
+                edge->x++;
+                edge->remainder -= edge->dy;
+            }
+
+            active[kept++] = edge;
+        }
+        active_count = kept;
+
+        // Skip the rows between separate parts of the polygon
+        if (active_count == 0 && next < edge_count)
+            y = edges[next].top;
     }
-    
 }
 
-void draw_quad_lines(int x1, int y1,
-                     int x2, int y2,
-                     int x3, int y3,
-                     int x4, int y4, char c)
+void draw_mirrored_rows(int x, int y, int row, int half_width, uint32_t glyph)
 {
-    cfw_draw_line(x1, y1, x2, y2, c);
-    cfw_draw_line(x2, y2, x3, y3, c);
-    cfw_draw_line(x3, y3, x4, y4, c);
-    cfw_draw_line(x4, y4, x1, y1, c);
+    // Fill the row above and below the center, which are the same
+    // row at the center itself
+    draw_span(x - half_width, x + half_width, y - row, glyph);
+    if (row != 0)
+        draw_span(x - half_width, x + half_width, y + row, glyph);
 }
 
-void draw_quad_fill(int x1, int y1,
-                    int x2, int y2,
-                    int x3, int y3,
-                    int x4, int y4, char c)
+// Rasterizers of the polygon modes. Points mode only draws the points
+// of the polygons, or the center of circles and ellipses.
+
+void points_line(int x1, int y1, int x2, int y2, uint32_t glyph)
 {
-    draw_triangle_fill(x1, y1, x2, y2, x3, y3, c);
-    draw_triangle_fill(x1, y1, x3, y3, x4, y4, c);
+    plot(x1, y1, glyph);
+    plot(x2, y2, glyph);
 }
 
-// DISCLAIMER: The circle rasterization code is from the
-// OneLoneCoders olcConsoleGameEngine project.
-//
-// Repository:
-// https://github.com/OneLoneCoder/videos/blob/master/olcConsoleGameEngine.h
+void points_triangle(int x1, int y1, int x2, int y2, int x3, int y3, uint32_t glyph)
+{
+    plot(x1, y1, glyph);
+    plot(x2, y2, glyph);
+    plot(x3, y3, glyph);
+}
 
-void draw_circle_lines(int x, int y, int radius, char c)
+void points_quad(int x1, int y1, int x2, int y2,
+                 int x3, int y3, int x4, int y4, uint32_t glyph)
 {
-    int tile_x = 0;
-    int tile_y = radius;
-    int f = 3 - 2 * radius;
+    plot(x1, y1, glyph);
+    plot(x2, y2, glyph);
+    plot(x3, y3, glyph);
+    plot(x4, y4, glyph);
+}
 
-    if (!radius) return;
-    
-    while (tile_y >= tile_x)
-    {
-        cfw_draw_char(x - tile_x, y - tile_y, c);
-        cfw_draw_char(x - tile_y, y - tile_x, c);
-        cfw_draw_char(x + tile_y, y - tile_x, c);
-        cfw_draw_char(x + tile_x, y - tile_y, c);
-        cfw_draw_char(x - tile_x, y + tile_y, c);
-        cfw_draw_char(x - tile_y, y + tile_x, c);
-        cfw_draw_char(x + tile_y, y + tile_x, c);
-        cfw_draw_char(x + tile_x, y + tile_y, c);
-        if (f < 0) f += 4 * tile_x++ + 6;
-        else f += 4 * (tile_x++ - tile_y--) + 10;
-    }
+void points_circle(int x, int y, int radius, uint32_t glyph)
+{
+    (void)radius;
+    plot(x, y, glyph);
 }
 
-void draw_strait(int sx, int ex, int ny, char c)
+void points_ellipse(int x, int y, int radius_x, int radius_y, uint32_t glyph)
 {
-    for (int i = sx; i <= ex; i++)
-        cfw_draw_char(i, ny, c);
+    (void)radius_x;
+    (void)radius_y;
+    plot(x, y, glyph);
 }
 
-void draw_circle_fill(int x, int y, int radius, char c)
+const __cfw_rasterizer points_rasterizer =
+{
+    points_line,
+    draw_points,
+    points_triangle,
+    points_quad,
+    points_circle,
+    points_ellipse,
+    draw_points
+};
+
+// The lines and fill modes are specialized from the same template
+
+#define RASTER_NAME(name)   lines_##name
+#define RASTER_FILL         0
+#include "raster.inl"
+
+#define RASTER_NAME(name)   fill_##name
+#define RASTER_FILL         1
+#include "raster.inl"
+
+// ------------------------------------------------------------------
+// |                        CFW internal API                        |
+// ------------------------------------------------------------------
+
+const __cfw_rasterizer *_cfw_get_rasterizer(int mode)
 {
-    int tile_x = 0;
-    int tile_y = radius;
-    int f = 3 - 2 * radius;
+    switch (mode)
+    {
+    case CFW_POINTS:
+        return &points_rasterizer;
+    case CFW_LINES:
+        return &lines_rasterizer;
+    default:
+        return &fill_rasterizer;
+    }
+}
 
-    if (!radius) return;
-    
-    while (tile_y >= tile_x)
+void *_cfw_get_scratch(size_t size)
+{
+    if (size > __cfw.scratch_size)
     {
-        draw_strait(x - tile_x, x + tile_x, y - tile_y, c);
-        draw_strait(x - tile_y, x + tile_y, y - tile_x, c);
-        draw_strait(x - tile_x, x + tile_x, y + tile_y, c);
-        draw_strait(x - tile_y, x + tile_y, y + tile_x, c);
-        if (f < 0) f += 4 * tile_x++ + 6;
-        else f += 4 * (tile_x++ - tile_y--) + 10;
+        // What the scratch memory held isn't needed anymore, so it
+        // doesn't have to be copied
+        free(__cfw.scratch);
+        __cfw.scratch = malloc(size);
+        __cfw.scratch_size = (__cfw.scratch != NULL) ? size : 0;
+
+        if (__cfw.scratch == NULL)
+        {
+            _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+            return NULL;
+        }
     }
+
+    return __cfw.scratch;
 }
 
-// End of OneLoneCoder code
+void _cfw_update_regions(void)
+{
+    // The bottom of the stack covers the entire console
+    __cfw_region *console = &__cfw.regions[0];
+    console->width       = __cfw.width;
+    console->height      = __cfw.height;
+    console->clip_right  = __cfw.width;
+    console->clip_bottom = __cfw.height;
+
+    // Clip the regions begun before the console got resized
+    for (int i = 1; i <= __cfw.region_depth; i++)
+        compose_region(&__cfw.regions[i], &__cfw.regions[i - 1]);
+}
 
 // ------------------------------------------------------------------
 // |                         CFW PUBLIC API                         |
@@ -279,7 +717,12 @@ void draw_circle_fill(int x, int y, int radius, char c)
 CFWAPI void cfw_clear(void)
 {
     CFW_REQUIRE_INIT();
-    _cfw_platform_clear();
+    _cfw_framebuffer_clear();
+    _cfw_canvas_clear();
+
+    // Styles and graphemes that were only drawn over now are no
+    // longer needed
+    _cfw_intern_collect();
 }
 
 CFWAPI void cfw_polygon_mode(int mode)
@@ -293,8 +736,23 @@ CFWAPI void cfw_polygon_mode(int mode)
         return;
     }
 
-    // Set the polygon mode
+    // Set the polygon mode, and the rasterizer that draws in it
     __cfw.polygon_mode = mode;
+    __cfw.rasterizer = _cfw_get_rasterizer(mode);
+}
+
+CFWAPI void cfw_fill_rule(int rule)
+{
+    CFW_REQUIRE_INIT();
+
+    // Check if the rule is not one of the permitted rules
+    if (rule != CFW_EVEN_ODD && rule != CFW_NONZERO)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "Rule 0x%x is not a valid fill rule.", rule);
+        return;
+    }
+
+    __cfw.fill_rule = rule;
 }
 
 CFWAPI void cfw_set_default_color(void)
@@ -302,16 +760,15 @@ CFWAPI void cfw_set_default_color(void)
     CFW_REQUIRE_INIT();
     CFW_REQUIRE_FEATURE_ENABLED(CFW_COLORS);
 
-    // Check if the color is valid
-    if (__cfw.foreground_color != -1 && __cfw.background_color != -1)
-        _cfw_platform_unset_color(__cfw.foreground_color, __cfw.background_color);
-
     // Set default colors
     __cfw.foreground_color = CFW_WHITE;
     __cfw.background_color = CFW_BLACK;
 
-    // There is no need to set the new colors, as they are already
-    // enabled when the previously bound color is unbound.
+    // Cells drawn from now on use the console default colors
+    __cfw.pen_style.fg = _CFW_COLOR_DEFAULT;
+    __cfw.pen_style.bg = _CFW_COLOR_DEFAULT;
+    __cfw.pen_style.attr = 0;
+    update_pen();
 }
 
 CFWAPI void cfw_set_color(int foreground_color, int background_color)
@@ -333,12 +790,39 @@ CFWAPI void cfw_set_color(int foreground_color, int background_color)
         return;
     }
 
-    _cfw_platform_unset_color(__cfw.foreground_color, __cfw.background_color);
-
     __cfw.foreground_color = foreground_color;
     __cfw.background_color = background_color;
 
-    _cfw_platform_set_color(__cfw.foreground_color, __cfw.background_color);
+    set_pen_foreground(foreground_color);
+    set_pen_background(background_color);
+    update_pen();
+}
+
+CFWAPI void cfw_set_color_rgb(int foreground_color, int background_color)
+{
+    CFW_REQUIRE_INIT();
+    CFW_REQUIRE_FEATURE_ENABLED(CFW_COLORS);
+
+    // Check if the color is valid
+    if (foreground_color < 0 || foreground_color > 0xFFFFFF)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "0x%x is not a valid foreground color.",
+                         foreground_color);
+        return;
+    }
+    else if (background_color < 0 || background_color > 0xFFFFFF)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "0x%x is not a valid background color.",
+                         background_color);
+        return;
+    }
+
+    // The colors are converted to what the console supports when
+    // the cells are sent to it
+    __cfw.pen_style.fg = _CFW_COLOR_RGB | foreground_color;
+    __cfw.pen_style.bg = _CFW_COLOR_RGB | background_color;
+    __cfw.pen_style.attr = 0;
+    update_pen();
 }
 
 CFWAPI void cfw_set_foreground_color(int color)
@@ -353,11 +837,10 @@ CFWAPI void cfw_set_foreground_color(int color)
         return;
     }
 
-    _cfw_platform_unset_color(__cfw.foreground_color, __cfw.background_color);
-    
     __cfw.foreground_color = color;
 
-    _cfw_platform_set_color(__cfw.foreground_color, __cfw.background_color);
+    set_pen_foreground(color);
+    update_pen();
 }
 
 CFWAPI void cfw_set_background_color(int color)
@@ -372,44 +855,51 @@ CFWAPI void cfw_set_background_color(int color)
         return;
     }
 
-    _cfw_platform_unset_color(__cfw.foreground_color, __cfw.background_color);
-
     __cfw.background_color = color;
 
-    _cfw_platform_set_color(__cfw.foreground_color, __cfw.background_color);
+    set_pen_background(color);
+    update_pen();
 }
 
 CFWAPI void cfw_begin_region(int x, int y, int width, int height)
 {
     CFW_REQUIRE_INIT();
 
-    // Allocate memory for region
-    __cfw_region *region = malloc(sizeof(__cfw_region));
+    // Check if there is room for another region
+    if (__cfw.region_depth == _CFW_REGION_STACK_SIZE)
+    {
+        // Still count the region, so the matching end doesn't pop
+        // one of the regions on the stack
+        __cfw.region_overflow++;
+        _cfw_input_error(CFW_INVALID_VALUE, "Regions can't be nested more than %d levels deep.",
+                         _CFW_REGION_STACK_SIZE);
+        return;
+    }
 
     // Set region bounds
+    __cfw_region *region = &__cfw.regions[__cfw.region_depth + 1];
     region->x = x;
     region->y = y;
     region->width = width;
     region->height = height;
 
-    // Save region
-    region->next = __cfw.region_head;
-    __cfw.region_head = region;
+    // Cache where the region is, so drawing doesn't have to look at
+    // the enclosing regions
+    compose_region(region, &__cfw.regions[__cfw.region_depth]);
+
+    // Push region
+    __cfw.region_depth++;
 }
 
 CFWAPI void cfw_end_region(void)
 {
     CFW_REQUIRE_INIT();
 
-    // If no region is currently set...
-    if (__cfw.region_head == NULL) return; // ... do nothing
-
-    // Pop region list
-    __cfw_region *region = __cfw.region_head;
-    __cfw.region_head = region->next;
-
-    // Delete region
-    free(region);
+    // Pop the regions that didn't fit on the stack first
+    if (__cfw.region_overflow > 0)
+        __cfw.region_overflow--;
+    else if (__cfw.region_depth > 0)
+        __cfw.region_depth--;
 }
 
 CFWAPI void cfw_get_region_bounds(int *width, int *height)
@@ -417,7 +907,7 @@ CFWAPI void cfw_get_region_bounds(int *width, int *height)
     CFW_REQUIRE_INIT();
 
     // If no region is currently set...
-    if (__cfw.region_head == NULL)
+    if (__cfw.region_depth == 0)
     {
         // ...return the size of the console
         cfw_get_console_size(width, height);
@@ -425,50 +915,188 @@ CFWAPI void cfw_get_region_bounds(int *width, int *height)
     else
     {
         // Get the size of the topmost region
-        __cfw_region *region = __cfw.region_head;
+        __cfw_region *region = &__cfw.regions[__cfw.region_depth];
         if (width != NULL)  *width  = region->width;
         if (height != NULL) *height = region->height;
     }
 }
 
+cfw__bool clip_rect(int *x, int *y, int *width, int *height)
+{
+    const __cfw_region *region = &__cfw.regions[__cfw.region_depth];
+
+    // Check if the size is valid
+    if (*width < 0 || *height < 0)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "%dx%d is not a valid rectangle size.",
+                         *width, *height);
+        return CFW_FALSE;
+    }
+
+    // Translate the rectangle to the console, and clip it to the
+    // visible part of the region
+    int left   = max(*x + region->offset_x, region->clip_left);
+    int top    = max(*y + region->offset_y, region->clip_top);
+    int right  = min(*x + region->offset_x + *width, region->clip_right);
+    int bottom = min(*y + region->offset_y + *height, region->clip_bottom);
+
+    *x = left;
+    *y = top;
+    *width = right - left;
+    *height = bottom - top;
+
+    return *width > 0 && *height > 0;
+}
+
+CFWAPI void cfw_fill_rect(int x, int y, int width, int height, char c)
+{
+    CFW_REQUIRE_INIT();
+
+    if (clip_rect(&x, &y, &width, &height))
+        _cfw_framebuffer_fill_rect(x, y, width, height, get_glyph(c));
+}
+
+CFWAPI void cfw_clear_rect(int x, int y, int width, int height)
+{
+    CFW_REQUIRE_INIT();
+
+    if (clip_rect(&x, &y, &width, &height))
+        _cfw_framebuffer_clear_rect(x, y, width, height);
+}
+
+CFWAPI void cfw_flood_fill(int x, int y, char c)
+{
+    CFW_REQUIRE_INIT();
+
+    const __cfw_region *region = &__cfw.regions[__cfw.region_depth];
+
+    // Translate the XY to the current bounds
+    if (!translate_xy_to_bounds(&x, &y)) return;
+
+    // The fill doesn't leave the region
+    _cfw_framebuffer_flood_fill(x, y, get_glyph(c), region->clip_left, region->clip_top,
+                                region->clip_right, region->clip_bottom);
+}
+
 CFWAPI void cfw_draw_char(int x, int y, char c)
 {
     CFW_REQUIRE_INIT();
 
     // Translate the XY to the current bounds
-    int overflow = translate_xy_to_bounds(&x, &y, 1);
-    if (overflow > 0) return;
+    if (!translate_xy_to_bounds(&x, &y)) return;
 
     // Draw the character
-    _cfw_platform_draw_char(x, y, c);
+    _cfw_framebuffer_put_char(x, y, get_glyph(c));
 }
 
 CFWAPI void cfw_draw_str(int x, int y, const char *str)
+{
+    cfw_draw_strn(x, y, str, strlen(str));
+}
+
+CFWAPI void cfw_draw_strn(int x, int y, const char *str, size_t length)
 {
     CFW_REQUIRE_INIT();
 
+    const __cfw_region *region = &__cfw.regions[__cfw.region_depth];
+
     // Translate the XY to the current bounds
-    int _length = strlen(str);
-    int overflow = translate_xy_to_bounds(&x, &y, _length);
-    if (overflow >= _length)
-        return; // The entire string is out of bounds, discard it.
-    else if (overflow > 0)
-    {
-        // Some, but not all of the characters fit. Only draw the
-        // characters that fit.
-
-        // A maximum of 1024 chars are allowed to be included after
-        // an overflow. If more than 1024 chars are overflowing the
-        // current region, it will be discarded. However, if you have
-        // more than 1024 chars overflowing, you have bigger
-        // problems.
-        char substr[1024];
-        substr(substr, str, 0, _length - overflow);
-        _cfw_platform_draw_str(x, y, substr);
+    x += region->offset_x;
+    y += region->offset_y;
+    if (y < region->clip_top || y >= region->clip_bottom)
+        return;
+
+    // The string is clipped one character at a time, as characters
+    // can be more than one byte long and one or two columns wide
+    if (x >= region->clip_right)
+        return;
+
+    _cfw_framebuffer_put_str(x, y, str, length,
+                             region->clip_left, region->clip_right);
+}
+
+CFWAPI void cfw_draw_strview(int x, int y, cfw__strview str)
+{
+    cfw_draw_strn(x, y, str.data, str.length);
+}
+
+CFWAPI void cfw_draw_attr_str(int x, int y, const char *text,
+                              const cfw__attr_run *runs, size_t run_count)
+{
+    CFW_REQUIRE_INIT();
+
+    // Check the runs up front, so nothing is drawn when one is wrong
+    for (size_t i = 0; i < run_count; i++)
+    {
+        if (!check_run(&runs[i]))
+            return;
     }
-    else
-        // Draw the string in its entirety
-        _cfw_platform_draw_str(x, y, str);
+
+    const __cfw_region *region = &__cfw.regions[__cfw.region_depth];
+
+    // Translate the XY to the current bounds once for all the runs
+    x += region->offset_x;
+    y += region->offset_y;
+    if (y < region->clip_top || y >= region->clip_bottom)
+        return;
+
+    // Runs with the same attributes as the one before them use the
+    // same style
+    const cfw__attr_run *previous = NULL;
+    uint32_t style = __cfw.pen.style;
+
+    for (size_t i = 0; i < run_count && x < region->clip_right; i++)
+    {
+        const cfw__attr_run *run = &runs[i];
+
+        if (previous == NULL || run->fg != previous->fg || run->bg != previous->bg ||
+            run->attrs != previous->attrs)
+        {
+            __cfw_style run_style;
+            get_run_style(run, &run_style);
+            style = _cfw_intern_style(&run_style);
+            previous = run;
+
+            // Drawing the run may intern graphemes, which can collect
+            // the styles before any cell references the new one
+            __cfw.pinned_style = style;
+        }
+
+        x = _cfw_framebuffer_put_run(x, y, text, run->length, style,
+                                     region->clip_left, region->clip_right);
+        text += run->length;
+    }
+
+    __cfw.pinned_style = _CFW_STYLE_DEFAULT;
+}
+
+int format_str(const char *fmt, va_list va)
+{
+    // The arguments can only be read once, so keep a copy in case
+    // the buffer is too small
+    va_list retry;
+    va_copy(retry, va);
+
+    int length = vsnprintf(__cfw.format_buffer, __cfw.format_buffer_size, fmt, va);
+
+    if (length >= 0 && (size_t)length >= __cfw.format_buffer_size)
+    {
+        char *buffer = realloc(__cfw.format_buffer, (size_t)length + 1);
+        if (buffer != NULL)
+        {
+            __cfw.format_buffer = buffer;
+            __cfw.format_buffer_size = (size_t)length + 1;
+            vsnprintf(buffer, __cfw.format_buffer_size, fmt, retry);
+        }
+        else
+        {
+            _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+            length = -1;
+        }
+    }
+
+    va_end(retry);
+    return length;
 }
 
 // In these following draw functions, they call other draw functions
@@ -477,113 +1105,104 @@ CFWAPI void cfw_draw_str(int x, int y, const char *str)
 
 CFWAPI void cfw_draw_fmt_str(int x, int y, const char *fmt, ...)
 {
-    // The longest possible formatted string is 1024 chars long.
-    char message[1024];
+    // The formatted string is kept in a buffer reused between calls
+    CFW_REQUIRE_INIT();
 
     // Format the string
     va_list va;
     va_start(va, fmt);
-    vsnprintf(message, sizeof(message), fmt, va);
+    int length = format_str(fmt, va);
     va_end(va);
 
     // Draw the formatted string
-    cfw_draw_str(x, y, message);
+    if (length > 0)
+        cfw_draw_strn(x, y, __cfw.format_buffer, length);
 }
 
-CFWAPI void cfw_draw_int(int x, int y, int i)
+CFWAPI void cfw_draw_bool(int x, int y, cfw__bool b)
 {
-    cfw_draw_fmt_str(x, y, "%d", i);
+    cfw_draw_str(x, y, (b ? "true" : "false"));
 }
 
-CFWAPI void cfw_draw_float(int x, int y, float f)
+CFWAPI void cfw_draw_line(int x1, int y1, int x2, int y2, char c)
 {
-    cfw_draw_fmt_str(x, y, "%f", f);
+    CFW_REQUIRE_INIT();
+
+    __cfw.rasterizer->line(x1, y1, x2, y2, get_glyph(c));
 }
 
-CFWAPI void cfw_draw_bool(int x, int y, cfw__bool b)
+CFWAPI void cfw_draw_polyline(const int *xy, size_t count, char c)
 {
-    cfw_draw_str(x, y, (b ? "true" : "false"));
+    CFW_REQUIRE_INIT();
+
+    __cfw.rasterizer->polyline(xy, count, get_glyph(c));
 }
 
-CFWAPI void cfw_draw_line(int x1, int y1, int x2, int y2, char c)
+CFWAPI void cfw_draw_points(const int *xy, size_t count, char c)
 {
-    switch (__cfw.polygon_mode)
-    {
-    case CFW_POINTS:
-        cfw_draw_char(x1, y1, c);
-        cfw_draw_char(x2, y2, c);
-        break;
-    case CFW_LINES:
-    case CFW_FILL:
-        // For a line, FILL and LINES give the same result.
-        draw_line(x1, y1, x2, y2, c);
-        break;
+    CFW_REQUIRE_INIT();
 
-    default:
-        break;
-    }
+    draw_points(xy, count, get_glyph(c));
+}
+
+CFWAPI void cfw_draw_polygon(const int *xy, size_t count, char c)
+{
+    CFW_REQUIRE_INIT();
+
+    __cfw.rasterizer->polygon(xy, count, get_glyph(c));
 }
 
 CFWAPI void cfw_draw_triangle(int x1, int y1, int x2, int y2,
                               int x3, int y3, char c)
 {
-    switch (__cfw.polygon_mode)
-    {
-    case CFW_POINTS:
-        cfw_draw_char(x1, y1, c);
-        cfw_draw_char(x2, y2, c);
-        cfw_draw_char(x3, y3, c);
-        break;
-    case CFW_LINES:
-        draw_triangle_lines(x1, y1, x2, y2, x3, y3, c);
-        break;
-    case CFW_FILL:
-        draw_triangle_fill(x1, y1, x2, y2, x3, y3, c);
-        break;
+    CFW_REQUIRE_INIT();
 
-    default:
-        break;
-    }
+    // Skip triangles that are entirely outside of the region
+    if (!is_box_visible(min(x1, min(x2, x3)), min(y1, min(y2, y3)),
+                        max(x1, max(x2, x3)), max(y1, max(y2, y3))))
+        return;
+
+    __cfw.rasterizer->triangle(x1, y1, x2, y2, x3, y3, get_glyph(c));
 }
 
 CFWAPI void cfw_draw_quad(int x1, int y1, int x2, int y2,
                           int x3, int y3, int x4, int y4, char c)
 {
-    switch (__cfw.polygon_mode)
-    {
-    case CFW_POINTS:
-        cfw_draw_char(x1, y1, c);
-        cfw_draw_char(x2, y2, c);
-        cfw_draw_char(x3, y3, c);
-        cfw_draw_char(x4, y4, c);
-        break;
-    case CFW_LINES:
-        draw_quad_lines(x1, y1, x2, y2, x3, y3, x4, y4, c);
-        break;
-    case CFW_FILL:
-        draw_quad_fill(x1, y1, x2, y2, x3, y3, x4, y4, c);
-        break;
+    CFW_REQUIRE_INIT();
 
-    default:
-        break;
-    }
+    // Skip quads that are entirely outside of the region
+    if (!is_box_visible(min(min(x1, x2), min(x3, x4)), min(min(y1, y2), min(y3, y4)),
+                        max(max(x1, x2), max(x3, x4)), max(max(y1, y2), max(y3, y4))))
+        return;
+
+    __cfw.rasterizer->quad(x1, y1, x2, y2, x3, y3, x4, y4, get_glyph(c));
 }
 
 CFWAPI void cfw_draw_circle(int x, int y, int radius, char c)
 {
-    switch (__cfw.polygon_mode)
+    CFW_REQUIRE_INIT();
+
+    // Check if the radius is valid
+    if (radius < 0)
     {
-    case CFW_POINTS:
-        _cfw_platform_draw_char(x, y, c);
-        break;
-    case CFW_LINES:
-        draw_circle_lines(x, y, radius, c);
-        break;
-    case CFW_FILL:
-        draw_circle_fill(x, y, radius, c);
-        break;
+        _cfw_input_error(CFW_INVALID_VALUE, "%d is not a valid circle radius.", radius);
+        return;
+    }
 
-    default:
-        break;
+    __cfw.rasterizer->circle(x, y, radius, get_glyph(c));
+}
+
+CFWAPI void cfw_draw_ellipse(int x, int y, int radius_x, int radius_y, char c)
+{
+    CFW_REQUIRE_INIT();
+
+    // Check if the radii are valid
+    if (radius_x < 0 || radius_y < 0)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "%d, %d are not valid ellipse radii.",
+                         radius_x, radius_y);
+        return;
     }
+
+    __cfw.rasterizer->ellipse(x, y, radius_x, radius_y, get_glyph(c));
 }
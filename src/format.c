@@ -0,0 +1,599 @@
+/**
+ * @file format.c
+ * @author Nicolai Frigaard
+ * @brief Implementation of the number drawing API.
+ *
+ * Numbers are formatted without going through printf. Integers are
+ * written two digits at a time, and floats are written with the
+ * fewest digits that still read back as the same float, found with
+ * the Ryu algorithm by Ulf Adams.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "float_tables.h"
+
+// Widest field a number can be padded to
+#define MAX_WIDTH 64
+
+// Longest number that can be written, before padding. The longest is
+// a 64-bit integer with thousands separators and 17 decimals.
+#define MAX_NUMBER 64
+
+// Highest number of decimals
+#define MAX_PRECISION 17
+
+// Scaled values from this on can't be rounded to an integer exactly
+#define MAX_EXACT_DOUBLE 9007199254740992.0
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint64_t powers_of_10[MAX_PRECISION + 1] =
+{
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u,
+    100000000u, 1000000000u, 10000000000u, 100000000000u,
+    1000000000000u, 10000000000000u, 100000000000000u,
+    1000000000000000u, 10000000000000000u, 100000000000000000u
+};
+
+// The numbers are written backwards, ending at the given pointer,
+// and these return where they start
+
+char *write_digits(char *end, uint64_t value)
+{
+    while (value >= 100)
+    {
+        const char *pair = &digit_pairs[(value % 100) * 2];
+        value /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+
+    if (value >= 10)
+    {
+        const char *pair = &digit_pairs[value * 2];
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    else
+        *--end = (char)('0' + value);
+
+    return end;
+}
+
+char *write_fixed_digits(char *end, uint64_t value, int count)
+{
+    // Leading zeros are kept
+    char *start = write_digits(end, value);
+    while (end - start < count)
+        *--start = '0';
+    return start;
+}
+
+char *write_integer(char *end, uint64_t value, int flags)
+{
+    if (!(flags & CFW_FORMAT_THOUSANDS))
+        return write_digits(end, value);
+
+    // Groups of three digits are separated by commas
+    while (value >= 1000)
+    {
+        end = write_fixed_digits(end, value % 1000, 3);
+        *--end = ',';
+        value /= 1000;
+    }
+
+    return write_digits(end, value);
+}
+
+void draw_number(int x, int y, cfw__bool negative, const char *number,
+                 int length, int columns, int width, int flags)
+{
+    char text[MAX_WIDTH + MAX_NUMBER + 1];
+    int size = 0;
+
+    if (negative)
+        columns++;
+
+    int padding = max(width - columns, 0);
+
+    if (!(flags & (CFW_FORMAT_ZERO_PAD | CFW_FORMAT_LEFT_ALIGN)))
+    {
+        memset(&text[size], ' ', padding);
+        size += padding;
+    }
+
+    if (negative)
+        text[size++] = '-';
+
+    // Zeros go between the sign and the digits
+    if ((flags & CFW_FORMAT_ZERO_PAD) && !(flags & CFW_FORMAT_LEFT_ALIGN))
+    {
+        memset(&text[size], '0', padding);
+        size += padding;
+    }
+
+    memcpy(&text[size], number, length);
+    size += length;
+
+    if (flags & CFW_FORMAT_LEFT_ALIGN)
+    {
+        memset(&text[size], ' ', padding);
+        size += padding;
+    }
+
+    cfw_draw_strn(x, y, text, size);
+}
+
+cfw__bool check_format(int width, int precision)
+{
+    if (width < 0 || width > MAX_WIDTH)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "%d is not a valid width.", width);
+        return CFW_FALSE;
+    }
+    if (precision < 0 || precision > MAX_PRECISION)
+    {
+        _cfw_input_error(CFW_INVALID_VALUE, "%d is not a valid precision.", precision);
+        return CFW_FALSE;
+    }
+
+    return CFW_TRUE;
+}
+
+char *write_special(char *end, double value)
+{
+    const char *text = isnan(value) ? "nan" : "inf";
+
+    end -= 3;
+    memcpy(end, text, 3);
+    return end;
+}
+
+char *write_fixed(char *end, double value, int precision, int flags)
+{
+    if (!isfinite(value))
+        return write_special(end, value);
+
+    // Round the value with the decimals as an integer, as long as
+    // that integer is exact
+    double scaled = value * (double)powers_of_10[precision];
+    if (scaled + 0.5 >= MAX_EXACT_DOUBLE)
+    {
+        char text[MAX_NUMBER];
+        int length = snprintf(text, sizeof(text), "%.*e", precision, value);
+        length = min(max(length, 0), (int)sizeof(text) - 1);
+
+        end -= length;
+        memcpy(end, text, length);
+        return end;
+    }
+
+    // The product is rounded, but its rounding error is exact with a
+    // fused multiply-add. As long as the fraction of the product is
+    // not a tie, the error is too small to change which way it
+    // rounds, so it only breaks ties. Exact ties are rounded to even,
+    // like printf does.
+    double error = fma(value, (double)powers_of_10[precision], -scaled);
+    double integer = floor(scaled);
+    double half = (scaled - integer) - 0.5;
+
+    uint64_t rounded = (uint64_t)integer;
+    if (half > 0.0 || (half == 0.0 && (error > 0.0 || (error == 0.0 && (rounded & 1)))))
+        rounded++;
+
+    if (precision > 0)
+    {
+        end = write_fixed_digits(end, rounded % powers_of_10[precision], precision);
+        *--end = '.';
+    }
+
+    return write_integer(end, rounded / powers_of_10[precision], flags);
+}
+
+// ------------------------------------------------------------------
+// |                      Ryu float formatting                      |
+// ------------------------------------------------------------------
+
+#define FLOAT_MANTISSA_BITS 23
+#define FLOAT_EXPONENT_BITS 8
+#define FLOAT_BIAS          127
+
+int pow5_factor(uint32_t value)
+{
+    int count = 0;
+    while (value % 5 == 0)
+    {
+        value /= 5;
+        count++;
+    }
+    return count;
+}
+
+cfw__bool is_multiple_of_pow5(uint32_t value, int p)
+{
+    return pow5_factor(value) >= p;
+}
+
+cfw__bool is_multiple_of_pow2(uint32_t value, int p)
+{
+    return (value & ((1u << p) - 1)) == 0;
+}
+
+// Number of bits of 5^e, or 1 for e = 0
+int pow5_bits(int e)
+{
+    return (int)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) and floor(log10(5^e))
+int log10_pow2(int e)
+{
+    return (int)(((uint32_t)e * 78913) >> 18);
+}
+
+int log10_pow5(int e)
+{
+    return (int)(((uint32_t)e * 732923) >> 20);
+}
+
+uint32_t mul_shift(uint32_t m, uint64_t factor, int shift)
+{
+    uint64_t low  = (uint64_t)m * (uint32_t)factor;
+    uint64_t high = (uint64_t)m * (uint32_t)(factor >> 32);
+    return (uint32_t)(((low >> 32) + high) >> (shift - 32));
+}
+
+void shortest_float(uint32_t mantissa, uint32_t exponent, uint32_t *digits, int *decimal_exponent)
+{
+    int e2;
+    uint32_t m2;
+
+    if (exponent == 0)
+    {
+        e2 = 1 - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+        m2 = mantissa;
+    }
+    else
+    {
+        e2 = (int)exponent - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+        m2 = (1u << FLOAT_MANTISSA_BITS) | mantissa;
+    }
+
+    cfw__bool accept_bounds = (m2 & 1) == 0;
+
+    // The interval of decimals that read back as the float, scaled
+    // by 4 so the bounds halfway to its neighbours are integers
+    uint32_t mv = 4 * m2;
+    uint32_t mp = 4 * m2 + 2;
+    int mm_shift = mantissa != 0 || exponent <= 1;
+    uint32_t mm = 4 * m2 - 1 - mm_shift;
+
+    // Convert the interval to decimal
+    uint32_t vr, vp, vm;
+    int e10;
+    cfw__bool vm_trailing_zeros = CFW_FALSE;
+    cfw__bool vr_trailing_zeros = CFW_FALSE;
+    int last_removed_digit = 0;
+
+    if (e2 >= 0)
+    {
+        int q = log10_pow2(e2);
+        e10 = q;
+
+        int k = FLOAT_POW5_INV_BITCOUNT + pow5_bits(q) - 1;
+        int i = -e2 + q + k;
+        vr = mul_shift(mv, float_pow5_inv_split[q], i);
+        vp = mul_shift(mp, float_pow5_inv_split[q], i);
+        vm = mul_shift(mm, float_pow5_inv_split[q], i);
+
+        if (q != 0 && (vp - 1) / 10 <= vm / 10)
+        {
+            // One removed digit is needed for rounding, even if no
+            // digits are removed below
+            int l = FLOAT_POW5_INV_BITCOUNT + pow5_bits(q - 1) - 1;
+            last_removed_digit = mul_shift(mv, float_pow5_inv_split[q - 1], -e2 + q - 1 + l) % 10;
+        }
+
+        if (q <= 9)
+        {
+            // Only one of mp, mv and mm can be a multiple of 5
+            if (mv % 5 == 0)
+                vr_trailing_zeros = is_multiple_of_pow5(mv, q);
+            else if (accept_bounds)
+                vm_trailing_zeros = is_multiple_of_pow5(mm, q);
+            else
+                vp -= is_multiple_of_pow5(mp, q);
+        }
+    }
+    else
+    {
+        int q = log10_pow5(-e2);
+        e10 = q + e2;
+
+        int i = -e2 - q;
+        int k = pow5_bits(i) - FLOAT_POW5_BITCOUNT;
+        int j = q - k;
+        vr = mul_shift(mv, float_pow5_split[i], j);
+        vp = mul_shift(mp, float_pow5_split[i], j);
+        vm = mul_shift(mm, float_pow5_split[i], j);
+
+        if (q != 0 && (vp - 1) / 10 <= vm / 10)
+        {
+            j = q - 1 - (pow5_bits(i + 1) - FLOAT_POW5_BITCOUNT);
+            last_removed_digit = mul_shift(mv, float_pow5_split[i + 1], j) % 10;
+        }
+
+        if (q <= 1)
+        {
+            // mv always has at least two trailing zero bits, and mm
+            // has one when mm_shift is 1
+            vr_trailing_zeros = CFW_TRUE;
+            if (accept_bounds)
+                vm_trailing_zeros = mm_shift == 1;
+            else
+                vp--;
+        }
+        else if (q < 31)
+            vr_trailing_zeros = is_multiple_of_pow2(mv, q - 1);
+    }
+
+    // Remove the digits the whole interval shares the value of
+    int removed = 0;
+    uint32_t output;
+
+    if (vm_trailing_zeros || vr_trailing_zeros)
+    {
+        while (vp / 10 > vm / 10)
+        {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+
+        if (vm_trailing_zeros)
+        {
+            while (vm % 10 == 0)
+            {
+                vr_trailing_zeros &= last_removed_digit == 0;
+                last_removed_digit = vr % 10;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+
+        // Round to even when the value is exactly halfway
+        if (vr_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0)
+            last_removed_digit = 4;
+
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) ||
+                       last_removed_digit >= 5);
+    }
+    else
+    {
+        // The common case, where no trailing zeros are involved
+        while (vp / 10 > vm / 10)
+        {
+            last_removed_digit = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+
+        output = vr + (vr == vm || last_removed_digit >= 5);
+    }
+
+    *digits = output;
+    *decimal_exponent = e10 + removed;
+}
+
+char *write_float(char *end, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t mantissa = bits & ((1u << FLOAT_MANTISSA_BITS) - 1);
+    uint32_t exponent = (bits >> FLOAT_MANTISSA_BITS) & ((1u << FLOAT_EXPONENT_BITS) - 1);
+
+    if (exponent == (1u << FLOAT_EXPONENT_BITS) - 1)
+        return write_special(end, value);
+    if (exponent == 0 && mantissa == 0)
+    {
+        *--end = '0';
+        return end;
+    }
+
+    uint32_t digits;
+    int decimal_exponent;
+    shortest_float(mantissa, exponent, &digits, &decimal_exponent);
+
+    char buffer[16];
+    char *start = write_digits(&buffer[sizeof(buffer)], digits);
+    int length = (int)(&buffer[sizeof(buffer)] - start);
+
+    // Position of the decimal point relative to the first digit.
+    // Like JavaScript, numbers are written out in full unless they
+    // are very large or small.
+    int point = length + decimal_exponent;
+
+    if (point > 21 || point <= -6)
+    {
+        // d.ddde+x
+        int exponent10 = point - 1;
+        end = write_digits(end, (uint64_t)abs(exponent10));
+        *--end = (exponent10 < 0) ? '-' : '+';
+        *--end = 'e';
+
+        end -= length - 1;
+        memcpy(end, start + 1, length - 1);
+        if (length > 1)
+            *--end = '.';
+        *--end = start[0];
+    }
+    else if (point <= 0)
+    {
+        // 0.000ddd
+        end -= length;
+        memcpy(end, start, length);
+        for (int i = 0; i < -point; i++)
+            *--end = '0';
+        *--end = '.';
+        *--end = '0';
+    }
+    else if (point >= length)
+    {
+        // ddd000
+        for (int i = 0; i < point - length; i++)
+            *--end = '0';
+        end -= length;
+        memcpy(end, start, length);
+    }
+    else
+    {
+        // ddd.ddd
+        end -= length - point;
+        memcpy(end, start + point, length - point);
+        *--end = '.';
+        end -= point;
+        memcpy(end, start, point);
+    }
+
+    return end;
+}
+
+// ------------------------------------------------------------------
+// |                         CFW PUBLIC API                         |
+// ------------------------------------------------------------------
+
+// The number drawing functions call cfw_draw_strn, which checks if
+// CFW is initialized
+
+CFWAPI void cfw_draw_int(int x, int y, int i)
+{
+    char buffer[MAX_NUMBER];
+    char *end = &buffer[sizeof(buffer)];
+
+    // Negate as unsigned, so the lowest int works as well
+    uint64_t magnitude = (i < 0) ? 0 - (uint64_t)(int64_t)i : (uint64_t)i;
+    char *start = write_digits(end, magnitude);
+    if (i < 0)
+        *--start = '-';
+
+    cfw_draw_strn(x, y, start, end - start);
+}
+
+CFWAPI void cfw_draw_uint64(int x, int y, uint64_t value, int width, int flags)
+{
+    if (!check_format(width, 0))
+        return;
+
+    char buffer[MAX_NUMBER];
+    char *end = &buffer[sizeof(buffer)];
+    char *start = write_integer(end, value, flags);
+
+    int length = (int)(end - start);
+    draw_number(x, y, CFW_FALSE, start, length, length, width, flags);
+}
+
+CFWAPI void cfw_draw_float(int x, int y, float f)
+{
+    char buffer[MAX_NUMBER];
+    char *end = &buffer[sizeof(buffer)];
+    char *start = write_float(end, fabsf(f));
+    if (signbit(f) && !isnan(f))
+        *--start = '-';
+
+    cfw_draw_strn(x, y, start, end - start);
+}
+
+CFWAPI void cfw_draw_fixed(int x, int y, double value, int width, int precision, int flags)
+{
+    if (!check_format(width, precision))
+        return;
+
+    char buffer[MAX_NUMBER];
+    char *end = &buffer[sizeof(buffer)];
+    char *start = write_fixed(end, fabs(value), precision, flags);
+
+    int length = (int)(end - start);
+    draw_number(x, y, value < 0, start, length, length, width, flags);
+}
+
+CFWAPI void cfw_draw_metric(int x, int y, double value, int width, int precision, int flags)
+{
+    // Prefixes from pico to exa, each 1000 times the previous one
+    static const char *prefixes[] =
+    {
+        "p", "n", "\xC2\xB5", "m", "", "k", "M", "G", "T", "P", "E"
+    };
+    enum { UNIT_PREFIX = 4, PREFIX_COUNT = sizeof(prefixes) / sizeof(prefixes[0]) };
+
+    if (!check_format(width, precision))
+        return;
+
+    double magnitude = fabs(value);
+
+    // Find the prefix that leaves between 1 and 1000 of it
+    int prefix = UNIT_PREFIX;
+    double scale = 1.0;
+    if (isfinite(magnitude) && magnitude != 0.0)
+    {
+        while (prefix < PREFIX_COUNT - 1 && magnitude >= scale * 1000.0)
+        {
+            scale *= 1000.0;
+            prefix++;
+        }
+        while (prefix > 0 && magnitude < scale)
+        {
+            scale /= 1000.0;
+            prefix--;
+        }
+
+        // Rounding can carry it up to 1000, like 999.96 to one
+        // decimal, which is 1.0 of the next prefix instead
+        double rounded = floor(magnitude / scale * (double)powers_of_10[precision] + 0.5);
+        if (rounded >= 1000.0 * (double)powers_of_10[precision] && prefix < PREFIX_COUNT - 1)
+        {
+            scale *= 1000.0;
+            prefix++;
+        }
+    }
+
+    char buffer[MAX_NUMBER];
+    char *end = &buffer[sizeof(buffer)];
+
+    const char *suffix = prefixes[prefix];
+    int suffix_length = (int)strlen(suffix);
+    end -= suffix_length;
+    memcpy(end, suffix, suffix_length);
+
+    char *start = write_fixed(end, magnitude / scale, precision, flags);
+
+    // The micro sign takes two bytes, but a single column
+    int length = (int)(&buffer[sizeof(buffer)] - start);
+    int columns = length - ((suffix_length > 1) ? suffix_length - 1 : 0);
+    draw_number(x, y, value < 0, start, length, columns, width, flags);
+}
@@ -0,0 +1,917 @@
+/**
+ * @file framebuffer.c
+ * @author Nicolai Frigaard
+ * @brief Implementation of the CFW framebuffer.
+ *
+ * CFW keeps its own copy of the console content. All draw calls
+ * write into the back buffer, and when the console is refreshed, the
+ * back buffer is compared to the front buffer (what is currently
+ * displayed) so only the cells that changed are sent to the
+ * platform.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+// Pick the widest vector instructions the compiler is allowed to use
+// for filling cells
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define _CFW_FILL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define _CFW_FILL_SSE2
+#endif
+
+#include "internal.h"
+
+static const __cfw_cell blank_cell = { ' ', _CFW_STYLE_DEFAULT };
+
+// Cells are filled a pattern of this many cells at a time. Its size
+// in bytes is a multiple of the vector size for every even cell size.
+#define FILL_PATTERN_CELLS 16
+
+void fill_cells(__cfw_cell *cells, int count, __cfw_cell cell)
+{
+    int i = 0;
+
+#if defined(_CFW_FILL_AVX2) || defined(_CFW_FILL_SSE2)
+    if (count >= FILL_PATTERN_CELLS)
+    {
+        __cfw_cell pattern[FILL_PATTERN_CELLS];
+        for (int j = 0; j < FILL_PATTERN_CELLS; j++)
+            pattern[j] = cell;
+
+        // Load the pattern into registers once, and store them over
+        // and over
+    #if defined(_CFW_FILL_AVX2)
+        #define FILL_VECTOR         __m256i
+        #define FILL_LOAD(p)        _mm256_loadu_si256((const __m256i *)(p))
+        #define FILL_STORE(p, v)    _mm256_storeu_si256((__m256i *)(p), (v))
+    #else
+        #define FILL_VECTOR         __m128i
+        #define FILL_LOAD(p)        _mm_loadu_si128((const __m128i *)(p))
+        #define FILL_STORE(p, v)    _mm_storeu_si128((__m128i *)(p), (v))
+    #endif
+
+        enum { VECTORS = sizeof(pattern) / (sizeof(FILL_VECTOR)) };
+        FILL_VECTOR vectors[VECTORS];
+        for (int j = 0; j < VECTORS; j++)
+            vectors[j] = FILL_LOAD((const char *)pattern + j * sizeof(FILL_VECTOR));
+
+        for (; i + FILL_PATTERN_CELLS <= count; i += FILL_PATTERN_CELLS)
+        {
+            char *out = (char *)&cells[i];
+            for (int j = 0; j < VECTORS; j++)
+                FILL_STORE(out + j * sizeof(FILL_VECTOR), vectors[j]);
+        }
+
+        #undef FILL_VECTOR
+        #undef FILL_LOAD
+        #undef FILL_STORE
+    }
+#endif
+
+    // Fill the cells that are left over
+    for (; i < count; i++)
+        cells[i] = cell;
+}
+
+// The fewest rows that must have moved before the console is
+// scrolled instead of drawing them again
+#define MIN_SCROLL_ROWS 2
+
+void mark_dirty(int y, int x1, int x2)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+    __cfw_row *row = &fb->rows[y];
+
+    row->dirty_min = min(row->dirty_min, x1);
+    row->dirty_max = max(row->dirty_max, x2);
+
+    fb->dirty = CFW_TRUE;
+}
+
+void mark_written(int y, int x1, int x2)
+{
+    mark_dirty(y, x1, x2);
+    __cfw.framebuffer.rows[y].blank = CFW_FALSE;
+}
+
+// Drawing over one half of a double-width character leaves the other
+// half blank. These are called with the first cell about to be
+// written, and the last cell that was written.
+
+void break_wide_char_left(int y, int x)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+    __cfw_cell *cells = &fb->back[y * fb->width];
+
+    if (cells[x].glyph == _CFW_GLYPH_CONTINUATION)
+    {
+        cells[x - 1].glyph = ' ';
+        mark_dirty(y, x - 1, x - 1);
+    }
+}
+
+void break_wide_char_right(int y, int x)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+    __cfw_cell *cells = &fb->back[y * fb->width];
+
+    if (x + 1 < fb->width && cells[x + 1].glyph == _CFW_GLYPH_CONTINUATION)
+    {
+        cells[x + 1].glyph = ' ';
+        mark_dirty(y, x + 1, x + 1);
+    }
+}
+
+uint64_t hash_row(const __cfw_cell *cells, int width)
+{
+    // Cells are hashed as 32-bit words, so they must not contain
+    // any padding
+    const unsigned char *data = (const unsigned char *)cells;
+    size_t words = width * sizeof(__cfw_cell) / sizeof(uint32_t);
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for (size_t i = 0; i < words; i++)
+    {
+        uint32_t word;
+        memcpy(&word, &data[i * sizeof(uint32_t)], sizeof(word));
+
+        hash ^= word;
+        hash *= 0x9E3779B97F4A7C15;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+void build_row_table(void)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+    int mask = fb->row_table_size - 1;
+
+    for (int i = 0; i < fb->row_table_size; i++)
+        fb->row_table[i].row = -1;
+
+    for (int y = 0; y < fb->height; y++)
+    {
+        uint64_t hash = fb->rows[y].front_hash;
+        int i = (int)(hash & mask);
+
+        while (fb->row_table[i].row != -1 && fb->row_table[i].hash != hash)
+            i = (i + 1) & mask;
+
+        // Rows that appear more than once, like blank ones, can't
+        // tell where a row moved from
+        fb->row_table[i].row = (fb->row_table[i].row == -1) ? y : -2;
+        fb->row_table[i].hash = hash;
+    }
+}
+
+int find_front_row(uint64_t hash)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+    int mask = fb->row_table_size - 1;
+    int i = (int)(hash & mask);
+
+    while (fb->row_table[i].row != -1)
+    {
+        if (fb->row_table[i].hash == hash)
+            return fb->row_table[i].row;
+        i = (i + 1) & mask;
+    }
+
+    return -1;
+}
+
+void scroll_front(int top, int bottom, int lines)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+    int count = bottom - top + 1 - abs(lines);
+    int exposed;
+
+    // Move the rows like the console did...
+    if (lines > 0)
+    {
+        memmove(&fb->front[top * fb->width], &fb->front[(top + lines) * fb->width],
+                (size_t)count * fb->width * sizeof(__cfw_cell));
+        for (int y = top; y < top + count; y++)
+            fb->rows[y].front_hash = fb->rows[y + lines].front_hash;
+        exposed = top + count;
+    }
+    else
+    {
+        memmove(&fb->front[(top - lines) * fb->width], &fb->front[top * fb->width],
+                (size_t)count * fb->width * sizeof(__cfw_cell));
+        for (int y = bottom; y >= top - lines; y--)
+            fb->rows[y].front_hash = fb->rows[y + lines].front_hash;
+        exposed = top;
+    }
+
+    // ...and blank the ones scrolled in, which now have to be
+    // compared against the back buffer
+    for (int y = exposed; y < exposed + abs(lines); y++)
+    {
+        fill_cells(&fb->front[y * fb->width], fb->width, blank_cell);
+        fb->rows[y].front_hash = fb->blank_hash;
+        mark_dirty(y, 0, fb->width - 1);
+    }
+}
+
+cfw__bool scroll_rows(void)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+    cfw__bool scrolled = CFW_FALSE;
+
+    build_row_table();
+
+    for (int y = 0; y < fb->height; )
+    {
+        // Look for a changed row that is displayed somewhere else
+        int source = -1;
+        if (fb->rows[y].hash != fb->rows[y].front_hash)
+            source = find_front_row(fb->rows[y].hash);
+
+        if (source < 0 || source == y)
+        {
+            y++;
+            continue;
+        }
+
+        // Find how many of the following rows moved along with it
+        int count = 1;
+        while (y + count < fb->height && source + count < fb->height &&
+               fb->rows[y + count].hash == fb->rows[source + count].front_hash)
+            count++;
+
+        if (count < MIN_SCROLL_ROWS)
+        {
+            y++;
+            continue;
+        }
+
+        // Scroll the region spanning both the old and new position
+        int top = min(y, source);
+        int bottom = max(y, source) + count - 1;
+        int lines = source - y;
+
+        if (!_cfw_platform_scroll(top, bottom, lines))
+            break; // The platform can't scroll
+
+        scroll_front(top, bottom, lines);
+        build_row_table();
+        scrolled = CFW_TRUE;
+
+        y += count;
+    }
+
+    return scrolled;
+}
+
+cfw__bool cells_equal(const __cfw_cell *a, const __cfw_cell *b)
+{
+    return a->glyph == b->glyph && a->style == b->style;
+}
+
+cfw__bool same_attributes(const __cfw_cell *a, const __cfw_cell *b)
+{
+    // Styles are interned, so equal styles have the same id
+    return a->style == b->style;
+}
+
+cfw__bool push_fill_span(int left, int right, int y, int dy)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    // The stack is kept between fills, so it only grows until it
+    // fits the largest fill
+    if (fb->fill_stack_size == fb->fill_stack_capacity)
+    {
+        int capacity = (fb->fill_stack_capacity > 0) ? fb->fill_stack_capacity * 2 : 64;
+        __cfw_fill_span *stack = realloc(fb->fill_stack, capacity * sizeof(__cfw_fill_span));
+        if (stack == NULL)
+        {
+            _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+            return CFW_FALSE;
+        }
+
+        fb->fill_stack = stack;
+        fb->fill_stack_capacity = capacity;
+    }
+
+    __cfw_fill_span *span = &fb->fill_stack[fb->fill_stack_size++];
+    span->left  = left;
+    span->right = right;
+    span->y     = y;
+    span->dy    = dy;
+
+    return CFW_TRUE;
+}
+
+void flush_run(int x, int y, const __cfw_cell *cells, int length)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    // The platform keeps the attributes until they are changed, so
+    // runs drawn with the same attributes as the previous one, even
+    // in an earlier frame, don't have to set them
+    if (cells->style != fb->style)
+    {
+        const __cfw_style *style = &__cfw.styles[cells->style];
+        _cfw_platform_set_attributes(style->fg, style->bg, style->attr);
+        fb->style = cells->style;
+    }
+
+    _cfw_platform_draw_cells(x, y, cells, length);
+}
+
+void invalidate_front(void)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    // A glyph of 0 is never drawn, so no cell matches the front buffer
+    __cfw_cell invalid_cell = blank_cell;
+    invalid_cell.glyph = '\0';
+    fill_cells(fb->front, fb->width * fb->height, invalid_cell);
+
+    for (int y = 0; y < fb->height; y++)
+    {
+        // Every row gets the same hash, so no rows are scrolled
+        fb->rows[y].front_hash = 0;
+        fb->rows[y].stale = CFW_FALSE;
+        mark_dirty(y, 0, fb->width - 1);
+    }
+
+    fb->invalid = CFW_FALSE;
+    fb->stale = CFW_FALSE;
+}
+
+void mark_stale_rows(void)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    // The rows no longer match their hash, and are compared cell by
+    // cell on the next pass
+    for (int y = 0; y < fb->height; y++)
+    {
+        if (!fb->rows[y].stale)
+            continue;
+
+        fb->rows[y].front_hash = 0;
+        fb->rows[y].stale = CFW_FALSE;
+        mark_dirty(y, 0, fb->width - 1);
+    }
+
+    fb->stale = CFW_FALSE;
+}
+
+cfw__bool flush_rows(void)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+    cfw__bool changed = CFW_FALSE;
+
+    // Hash the rows that have been written to. The other rows are
+    // identical to the front buffer.
+    for (int y = 0; y < fb->height; y++)
+    {
+        __cfw_row *row = &fb->rows[y];
+
+        if (row->dirty_min <= row->dirty_max)
+            row->hash = hash_row(&fb->back[y * fb->width], fb->width);
+        else
+            row->hash = row->front_hash;
+    }
+
+    // Let the console move the rows that only changed position
+    changed = scroll_rows();
+
+    for (int y = 0; y < fb->height; y++)
+    {
+        __cfw_row *row = &fb->rows[y];
+
+        // Skip the rows that haven't been written to, or that ended
+        // up identical to what is displayed
+        if (row->dirty_min > row->dirty_max || row->hash == row->front_hash)
+        {
+            row->dirty_min = fb->width;
+            row->dirty_max = -1;
+            continue;
+        }
+
+        __cfw_cell *back  = &fb->back[y * fb->width];
+        __cfw_cell *front = &fb->front[y * fb->width];
+
+        // Only the damaged span of the row can differ from what is
+        // currently displayed
+        int x = row->dirty_min;
+        int end = row->dirty_max + 1;
+        while (x < end)
+        {
+            // Skip the cells that are already displayed
+            if (cells_equal(&back[x], &front[x]))
+            {
+                x++;
+                continue;
+            }
+
+            // Find the run of changed cells sharing the same
+            // attributes, so they can be drawn in a single call
+            int start = x;
+            while (x < end &&
+                   !cells_equal(&back[x], &front[x]) &&
+                   same_attributes(&back[x], &back[start]))
+                x++;
+
+            // Both halves of a double-width character are drawn
+            // together, even if only one of them changed
+            if (back[start].glyph == _CFW_GLYPH_CONTINUATION)
+                start--;
+            if (x < fb->width && back[x].glyph == _CFW_GLYPH_CONTINUATION)
+                x++;
+
+            flush_run(start, y, &back[start], x - start);
+            memcpy(&front[start], &back[start],
+                   (x - start) * sizeof(__cfw_cell));
+
+            changed = CFW_TRUE;
+        }
+
+        row->dirty_min = fb->width;
+        row->dirty_max = -1;
+        row->front_hash = row->hash;
+    }
+
+    fb->dirty = CFW_FALSE;
+
+    return changed;
+}
+
+// ------------------------------------------------------------------
+// |                        CFW internal API                        |
+// ------------------------------------------------------------------
+
+cfw__bool _cfw_framebuffer_resize(int width, int height)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    if (width < 0)  width = 0;
+    if (height < 0) height = 0;
+
+    size_t count = (size_t)width * (size_t)height;
+
+    // Allocate the new buffers. One extra cell is allocated so a
+    // zero-sized console still gets valid pointers.
+    __cfw_cell *back  = malloc((count + 1) * sizeof(__cfw_cell));
+    __cfw_cell *front = malloc((count + 1) * sizeof(__cfw_cell));
+    __cfw_row *rows   = malloc(((size_t)height + 1) * sizeof(__cfw_row));
+    char *line        = malloc((size_t)width * _CFW_GRAPHEME_MAX_SIZE + 1);
+
+    // The row table is kept at most half full
+    int table_size = 1;
+    while (table_size < height * 2)
+        table_size *= 2;
+
+    void *row_table   = malloc(table_size * sizeof(*fb->row_table));
+
+    if (back == NULL || front == NULL || rows == NULL || line == NULL ||
+        row_table == NULL)
+    {
+        free(back);
+        free(front);
+        free(rows);
+        free(line);
+        free(row_table);
+
+        _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+        return CFW_FALSE;
+    }
+
+    fill_cells(back, count, blank_cell);
+    fill_cells(front, count, blank_cell);
+
+    // Keep whatever has been drawn to the part of the back buffer
+    // that is still visible
+    if (fb->back != NULL)
+    {
+        int copy_width  = min(width, fb->width);
+        int copy_height = min(height, fb->height);
+
+        for (int y = 0; y < copy_height; y++)
+        {
+            memcpy(&back[y * width], &fb->back[y * fb->width],
+                   copy_width * sizeof(__cfw_cell));
+
+            // Double-width characters cut in half by the new width
+            // are left blank
+            if (copy_width < fb->width &&
+                fb->back[y * fb->width + copy_width].glyph == _CFW_GLYPH_CONTINUATION)
+                back[y * width + copy_width - 1].glyph = ' ';
+        }
+    }
+
+    // The platform starts out drawing with the default attributes
+    if (fb->back == NULL)
+        fb->style = _CFW_STYLE_DEFAULT;
+
+    _cfw_framebuffer_free();
+
+    fb->width  = width;
+    fb->height = height;
+    fb->back   = back;
+    fb->front  = front;
+    fb->rows   = rows;
+    fb->line   = line;
+
+    fb->row_table = row_table;
+    fb->row_table_size = table_size;
+    fb->blank_hash = (height > 0) ? hash_row(front, width) : 0;
+
+    // The front buffer is blank, so the console has to be as well
+    _cfw_platform_clear();
+    fb->stale = CFW_FALSE;
+
+    // Every row has to be compared against the blank front buffer
+    // on the next refresh
+    for (int y = 0; y < height; y++)
+    {
+        rows[y].blank = CFW_FALSE;
+        rows[y].stale = CFW_FALSE;
+        rows[y].dirty_min = width;
+        rows[y].dirty_max = -1;
+        rows[y].front_hash = fb->blank_hash;
+        mark_dirty(y, 0, width - 1);
+    }
+
+    return CFW_TRUE;
+}
+
+void _cfw_framebuffer_free(void)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    free(fb->back);
+    free(fb->front);
+    free(fb->rows);
+    free(fb->line);
+    free(fb->row_table);
+    free(fb->fill_stack);
+
+    memset(fb, 0, sizeof(*fb));
+}
+
+void _cfw_framebuffer_clear(void)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    for (int y = 0; y < fb->height; y++)
+    {
+        // Rows that are already blank stay untouched, so clearing a
+        // mostly empty console doesn't make it dirty
+        if (fb->rows[y].blank)
+            continue;
+
+        fill_cells(&fb->back[y * fb->width], fb->width, blank_cell);
+        mark_dirty(y, 0, fb->width - 1);
+        fb->rows[y].blank = CFW_TRUE;
+    }
+}
+
+// The put functions don't clip. Everything drawn is already clipped
+// to the current region, which never reaches outside the console.
+
+void _cfw_framebuffer_put_char(int x, int y, uint32_t glyph)
+{
+    _cfw_framebuffer_put_cell(x, y, glyph, __cfw.pen.style);
+}
+
+void _cfw_framebuffer_put_cell(int x, int y, uint32_t glyph, uint32_t style)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    break_wide_char_left(y, x);
+
+    __cfw_cell *cell = &fb->back[y * fb->width + x];
+    cell->glyph = glyph;
+    cell->style = style;
+
+    break_wide_char_right(y, x);
+    mark_written(y, x, x);
+}
+
+void _cfw_framebuffer_put_str(int x, int y, const char *str, size_t length, int left, int right)
+{
+    _cfw_framebuffer_put_run(x, y, str, length, __cfw.pen.style, left, right);
+}
+
+int _cfw_framebuffer_put_run(int x, int y, const char *str, size_t length, uint32_t style,
+                             int left, int right)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    __cfw_cell *cells = &fb->back[y * fb->width];
+    const char *end = str + length;
+
+    __cfw_cell cell = { 0, style };
+    int first = -1, last = -1;
+
+    int column = x;
+    while (str < end && column < right)
+    {
+        uint32_t glyph;
+        int width;
+
+        // Printable ASCII is a single column wide, and only has to be
+        // decoded as a grapheme when marks may follow it
+        unsigned char c = (unsigned char)*str;
+        if (c >= ' ' && c <= '~' &&
+            (str + 1 == end || (unsigned char)str[1] < 0x80))
+        {
+            glyph = c;
+            width = 1;
+            str++;
+        }
+        else
+        {
+            // Interning the grapheme may collect the tables, which is
+            // why every grapheme is written before the next one is
+            // decoded, and the style of the run has to be referenced
+            glyph = _cfw_utf8_decode_grapheme(&str, end, &width);
+
+            // Characters without a width aren't drawn
+            if (width == 0)
+                continue;
+        }
+
+        if (column + width <= left)
+        {
+            column += width;
+            continue;
+        }
+
+        // Only one half of a double-width character is visible at
+        // the edges, which is left blank
+        int start = column;
+        if (column < left || column + width > right)
+        {
+            glyph = ' ';
+            start = max(column, left);
+            width = 1;
+        }
+
+        if (first < 0)
+        {
+            first = start;
+            break_wide_char_left(y, first);
+        }
+
+        cell.glyph = glyph;
+        cells[start] = cell;
+        if (width == 2)
+        {
+            cell.glyph = _CFW_GLYPH_CONTINUATION;
+            cells[start + 1] = cell;
+        }
+
+        last = start + width - 1;
+        column = start + width;
+    }
+
+    if (first < 0)
+        return column;
+
+    break_wide_char_right(y, last);
+    mark_written(y, first, last);
+
+    // Where the next run starts
+    return column;
+}
+
+void _cfw_framebuffer_put_span(int x, int y, uint32_t glyph, int length)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    __cfw_cell cell = __cfw.pen;
+    cell.glyph = glyph;
+
+    break_wide_char_left(y, x);
+    fill_cells(&fb->back[y * fb->width + x], length, cell);
+    break_wide_char_right(y, x + length - 1);
+
+    mark_written(y, x, x + length - 1);
+}
+
+void _cfw_framebuffer_put_cells(int x, int y, const __cfw_cell *cells, int length)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    break_wide_char_left(y, x);
+    memcpy(&fb->back[y * fb->width + x], cells, length * sizeof(__cfw_cell));
+    break_wide_char_right(y, x + length - 1);
+
+    mark_written(y, x, x + length - 1);
+}
+
+void _cfw_framebuffer_fill_rect(int x, int y, int width, int height, uint32_t glyph)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    __cfw_cell cell = __cfw.pen;
+    cell.glyph = glyph;
+
+    for (int row = y; row < y + height; row++)
+    {
+        break_wide_char_left(row, x);
+        fill_cells(&fb->back[row * fb->width + x], width, cell);
+        break_wide_char_right(row, x + width - 1);
+
+        mark_written(row, x, x + width - 1);
+    }
+}
+
+void _cfw_framebuffer_clear_rect(int x, int y, int width, int height)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    for (int row = y; row < y + height; row++)
+    {
+        if (fb->rows[row].blank)
+            continue;
+
+        break_wide_char_left(row, x);
+        fill_cells(&fb->back[row * fb->width + x], width, blank_cell);
+        break_wide_char_right(row, x + width - 1);
+
+        mark_dirty(row, x, x + width - 1);
+
+        // Clearing the entire row makes it blank again
+        if (width == fb->width)
+            fb->rows[row].blank = CFW_TRUE;
+    }
+}
+
+void _cfw_framebuffer_flood_fill(int x, int y, uint32_t glyph,
+                                 int left, int top, int right, int bottom)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    // Filling from the second half of a double-width character fills
+    // from the character
+    if (fb->back[y * fb->width + x].glyph == _CFW_GLYPH_CONTINUATION && x > left)
+        x--;
+
+    // The cells like the one filled from are filled, and they are
+    // done once they are like the fill
+    __cfw_cell target = fb->back[y * fb->width + x];
+    __cfw_cell fill = __cfw.pen;
+    fill.glyph = glyph;
+
+    if (cells_equal(&target, &fill))
+        return;
+
+    fb->fill_stack_size = 0;
+    push_fill_span(x, x, y, 1);
+    push_fill_span(x, x, y - 1, -1);
+
+    while (fb->fill_stack_size > 0)
+    {
+        __cfw_fill_span span = fb->fill_stack[--fb->fill_stack_size];
+        if (span.y < top || span.y >= bottom)
+            continue;
+
+        const __cfw_cell *row = &fb->back[span.y * fb->width];
+        int dy = span.dy;
+        int x1 = span.left;
+
+        // Extend the span to the left. What's found there leaks back
+        // into the row the span came from.
+        int start = x1;
+        if (cells_equal(&row[start], &target))
+        {
+            while (start > left && cells_equal(&row[start - 1], &target))
+                start--;
+
+            if (start < x1 && !push_fill_span(start, x1 - 1, span.y - dy, -dy))
+                return;
+        }
+
+        while (x1 <= span.right)
+        {
+            while (x1 < right && cells_equal(&row[x1], &target))
+                x1++;
+
+            if (x1 > start)
+            {
+                _cfw_framebuffer_put_span(start, span.y, glyph, x1 - start);
+
+                // Continue into the next row, and back into the row
+                // the span came from where it reaches past that span
+                if (!push_fill_span(start, x1 - 1, span.y + dy, dy))
+                    return;
+                if (x1 - 1 > span.right && !push_fill_span(span.right + 1, x1 - 1, span.y - dy, -dy))
+                    return;
+            }
+
+            // Skip to the next cell to fill within the span
+            x1++;
+            while (x1 < span.right && !cells_equal(&row[x1], &target))
+                x1++;
+            start = x1;
+        }
+    }
+}
+
+const char *_cfw_framebuffer_encode_cells(const __cfw_cell *cells, int length)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    // The second half of double-width characters isn't drawn
+    char *out = fb->line;
+    for (int i = 0; i < length; i++)
+    {
+        uint32_t glyph = cells[i].glyph;
+
+        if (glyph & _CFW_GLYPH_GRAPHEME)
+        {
+            const __cfw_grapheme *grapheme = &__cfw.graphemes[glyph & ~_CFW_GLYPH_GRAPHEME];
+            memcpy(out, grapheme->text, grapheme->length);
+            out += grapheme->length;
+        }
+        else if (glyph != _CFW_GLYPH_CONTINUATION)
+            out += _cfw_utf8_encode(glyph, out);
+    }
+    *out = '\0';
+
+    return fb->line;
+}
+
+void _cfw_framebuffer_invalidate(void)
+{
+    // The front buffer is replaced on the next flush, or at the end of
+    // the current one, so the rows being drawn stay consistent
+    __cfw.framebuffer.invalid = CFW_TRUE;
+}
+
+void _cfw_framebuffer_invalidate_cells(int x, int y, int length)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    if (y < 0 || y >= fb->height)
+        return;
+
+    if (x < 0)
+    {
+        length += x;
+        x = 0;
+    }
+    length = min(length, fb->width - x);
+    if (length <= 0)
+        return;
+
+    // This may be called in the middle of a flush, so the cells are
+    // only taken out of the front buffer, and the row is marked dirty
+    // once the rows being drawn are done
+    __cfw_cell *front = &fb->front[y * fb->width + x];
+    for (int i = 0; i < length; i++)
+        front[i].glyph = '\0';
+
+    fb->rows[y].stale = CFW_TRUE;
+    fb->stale = CFW_TRUE;
+}
+
+cfw__bool _cfw_framebuffer_flush(void)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    if (fb->invalid)
+        invalidate_front();
+    if (fb->stale)
+        mark_stale_rows();
+
+    // Nothing has been drawn since the last refresh
+    if (!fb->dirty)
+        return CFW_FALSE;
+
+    cfw__bool changed = flush_rows();
+
+    // Drawing may make the platform lose track of what is displayed,
+    // in which case everything is drawn again right away
+    if (fb->invalid)
+    {
+        invalidate_front();
+        flush_rows();
+    }
+
+    // ...and so are the cells it drew wrong. Cells it still can't draw
+    // right are left for the next refresh.
+    if (fb->stale)
+    {
+        mark_stale_rows();
+        flush_rows();
+    }
+
+    return changed;
+}
@@ -12,6 +12,7 @@
 #include <memory.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "internal.h"
 
@@ -56,6 +57,9 @@ void _cfw_input_error(int errorcode, const char *fmt, ...)
         case CFW_NOT_ENABLED:
             strcpy(message, "CFW feature is not enabled");
             break;
+        case CFW_OUT_OF_MEMORY:
+            strcpy(message, "CFW ran out of memory");
+            break;
         default:
             strcpy(message, "Unknown error");
             break;
@@ -88,15 +92,35 @@ CFWAPI cfw__bool cfw_init(void)
 
     // Set default values
     __cfw.polygon_mode = CFW_FILL;
+    __cfw.rasterizer = _cfw_get_rasterizer(CFW_FILL);
+    __cfw.fill_rule = CFW_NONZERO;
+    __cfw.canvas.mode = CFW_CELLS;
+    __cfw.dither_mode = CFW_DITHER_ORDERED;
     __cfw.foreground_color = -1;
     __cfw.background_color = -1;
+    __cfw.pen.glyph = ' ';
+    __cfw.pen.style = _CFW_STYLE_DEFAULT;
+    __cfw.pen_style.fg = _CFW_COLOR_DEFAULT;
+    __cfw.pen_style.bg = _CFW_COLOR_DEFAULT;
 
     // CFW is now initialized
     __cfw.initialized = CFW_TRUE;
 
-    // Cache console size
+    if (!_cfw_intern_init())
+    {
+        cfw_terminate();
+        return CFW_FALSE;
+    }
+
+    // Cache console size, which also allocates the framebuffer
     cfw_get_console_size(&__cfw.width, &__cfw.height);
 
+    if (__cfw.framebuffer.back == NULL)
+    {
+        cfw_terminate();
+        return CFW_FALSE;
+    }
+
     return CFW_TRUE;
 }
 
@@ -111,6 +135,13 @@ CFWAPI void cfw_terminate(void)
     // Terminate the platform specific code
     _cfw_platform_terminate();
 
+    // Free the framebuffer, and what its cells referenced
+    _cfw_framebuffer_free();
+    _cfw_canvas_free();
+    _cfw_intern_free();
+    free(__cfw.format_buffer);
+    free(__cfw.scratch);
+
     // The memset that sets the entire __cfw struct to 0 also sets
     // the initialized variable to false, but it's more clear this
     // way.
@@ -142,7 +173,18 @@ CFWAPI void cfw_refresh(void)
 {
     CFW_REQUIRE_INIT();
     _cfw_poll_input();
-    _cfw_platform_refresh();
+
+    // Catch up with whatever happened to the console since the last
+    // refresh
+    _cfw_platform_sync();
+
+    // Dots drawn to the canvas are shown in their cells
+    _cfw_canvas_pack();
+
+    // Send the cells that changed since the last refresh. If none
+    // did, the console is left alone.
+    if (_cfw_framebuffer_flush())
+        _cfw_platform_refresh();
 }
 
 CFWAPI cfw__bool cfw_is_feature_supported(int feature)
@@ -174,4 +216,30 @@ CFWAPI void cfw_get_console_size(int *width, int *height)
     // variables... shh...
     __cfw.width  = _width;
     __cfw.height = _height;
+
+    // The regions are clipped to the console
+    if (__cfw.regions[0].clip_right != _width ||
+        __cfw.regions[0].clip_bottom != _height)
+        _cfw_update_regions();
+
+    // The canvas is packed before the framebuffer is resized, so the
+    // dots drawn to it so far are kept in their cells
+    cfw__bool resize_canvas = __cfw.canvas.mode != CFW_CELLS &&
+        (__cfw.canvas.width != _width || __cfw.canvas.height != _height);
+    if (resize_canvas)
+        _cfw_canvas_pack();
+
+    // The framebuffer always covers the entire console
+    if (__cfw.framebuffer.back == NULL ||
+        __cfw.framebuffer.width != _width ||
+        __cfw.framebuffer.height != _height)
+        _cfw_framebuffer_resize(_width, _height);
+
+    // ...and so does the canvas. Geometry is drawn to cells again if
+    // there isn't memory for it.
+    if (resize_canvas && !_cfw_canvas_resize(_width, _height))
+    {
+        _cfw_canvas_free();
+        __cfw.canvas.mode = CFW_CELLS;
+    }
 }
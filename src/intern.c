@@ -0,0 +1,316 @@
+/**
+ * @file intern.c
+ * @author Nicolai Frigaard
+ * @brief Implementation of the interned cell styles and graphemes.
+ *
+ * Cells only hold a glyph and a style id, so they can be compared
+ * and copied as a single 64-bit value. The colors and attributes of
+ * a cell are stored once per combination in the style table, and
+ * graphemes made of more than one codepoint are stored in the
+ * grapheme table.
+ *
+ * Entries nothing references anymore are released when the tables
+ * are collected, which happens when the console is cleared, or when
+ * a table is full.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+// Number of entries a table starts out with
+#define MIN_CAPACITY 64
+
+uint32_t hash_bytes(const void *data, size_t size)
+{
+    // 32-bit FNV-1a
+    const unsigned char *bytes = data;
+    uint32_t hash = 0x811C9DC5;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+void free_table(__cfw_intern *table)
+{
+    free(table->buckets);
+    free(table->next);
+    free(table->hashes);
+    free(table->references);
+
+    memset(table, 0, sizeof(*table));
+}
+
+cfw__bool grow_table(__cfw_intern *table, void **entries, size_t entry_size)
+{
+    int capacity = (table->capacity > 0) ? table->capacity * 2 : MIN_CAPACITY;
+
+    // Every array is assigned as soon as it has been reallocated, so
+    // nothing is lost if a later one fails
+    void *new_entries = realloc(*entries, capacity * entry_size);
+    if (new_entries != NULL)
+        *entries = new_entries;
+
+    int *next = realloc(table->next, capacity * sizeof(int));
+    if (next != NULL)
+        table->next = next;
+
+    uint32_t *hashes = realloc(table->hashes, capacity * sizeof(uint32_t));
+    if (hashes != NULL)
+        table->hashes = hashes;
+
+    int *references = realloc(table->references, capacity * sizeof(int));
+    if (references != NULL)
+        table->references = references;
+
+    // There is one bucket per entry
+    int *buckets = malloc(capacity * sizeof(int));
+
+    if (new_entries == NULL || next == NULL || hashes == NULL ||
+        references == NULL || buckets == NULL)
+    {
+        free(buckets);
+        _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+        return CFW_FALSE;
+    }
+
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_mask = capacity - 1;
+    table->capacity = capacity;
+
+    // Rebuild the chains. Free entries keep their place in the list
+    // of free entries.
+    for (int i = 0; i < capacity; i++)
+        buckets[i] = -1;
+
+    for (int id = 0; id < table->count; id++)
+    {
+        if (table->references[id] < 0)
+            continue;
+
+        int *bucket = &buckets[table->hashes[id] & table->bucket_mask];
+        table->next[id] = *bucket;
+        *bucket = id;
+    }
+
+    return CFW_TRUE;
+}
+
+int allocate_entry(__cfw_intern *table, void **entries, size_t entry_size, uint32_t hash)
+{
+    if (table->free < 0 && table->count == table->capacity)
+    {
+        // Entries drawn over since the last collection may free up
+        // enough room, which is worth checking when many have been
+        // added since then. Only the ids stored where the collection
+        // looks are kept, see _cfw_intern_collect.
+        if (table->added >= table->capacity / 2)
+            _cfw_intern_collect();
+
+        if (table->free < 0 && !grow_table(table, entries, entry_size))
+            return -1;
+    }
+
+    int id;
+    if (table->free >= 0)
+    {
+        id = table->free;
+        table->free = table->next[id];
+    }
+    else
+        id = table->count++;
+
+    int *bucket = &table->buckets[hash & table->bucket_mask];
+    table->next[id] = *bucket;
+    *bucket = id;
+
+    table->hashes[id] = hash;
+    table->references[id] = 0;
+    table->added++;
+
+    return id;
+}
+
+void count_references(const __cfw_cell *cells, size_t count)
+{
+    int *styles = __cfw.style_table.references;
+    int *graphemes = __cfw.grapheme_table.references;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        styles[cells[i].style]++;
+
+        if (cells[i].glyph & _CFW_GLYPH_GRAPHEME)
+            graphemes[cells[i].glyph & ~_CFW_GLYPH_GRAPHEME]++;
+    }
+}
+
+void release_unreferenced(__cfw_intern *table)
+{
+    for (int id = 0; id < table->count; id++)
+    {
+        if (table->references[id] != 0)
+            continue;
+
+        // Unlink the entry from its chain
+        int *link = &table->buckets[table->hashes[id] & table->bucket_mask];
+        while (*link != id)
+            link = &table->next[*link];
+        *link = table->next[id];
+
+        if (table == &__cfw.grapheme_table)
+            free(__cfw.graphemes[id].text);
+
+        table->references[id] = -1;
+        table->next[id] = table->free;
+        table->free = id;
+    }
+
+    table->added = 0;
+}
+
+// ------------------------------------------------------------------
+// |                        CFW internal API                        |
+// ------------------------------------------------------------------
+
+cfw__bool _cfw_intern_init(void)
+{
+    __cfw.style_table.free = -1;
+    __cfw.grapheme_table.free = -1;
+
+    // The default style gets the first id
+    __cfw_style style = { _CFW_COLOR_DEFAULT, _CFW_COLOR_DEFAULT, 0 };
+    _cfw_intern_style(&style);
+
+    return __cfw.style_table.count == 1;
+}
+
+void _cfw_intern_free(void)
+{
+    for (int id = 0; id < __cfw.grapheme_table.count; id++)
+    {
+        if (__cfw.grapheme_table.references[id] >= 0)
+            free(__cfw.graphemes[id].text);
+    }
+
+    free(__cfw.styles);
+    free(__cfw.graphemes);
+    __cfw.styles = NULL;
+    __cfw.graphemes = NULL;
+
+    free_table(&__cfw.style_table);
+    free_table(&__cfw.grapheme_table);
+}
+
+// Collecting releases every entry that isn't referenced by a cell of
+// the back or front buffer, a cell of the canvas, the pen, the pinned
+// style or the style last passed to the platform. It also runs from
+// inside _cfw_intern_style and _cfw_intern_grapheme when a table is
+// full, so an id that was just interned has to be stored in one of
+// those places before anything else is interned. Draw calls either
+// write the cells of an id before interning the next one, or pin the
+// style while they intern graphemes.
+void _cfw_intern_collect(void)
+{
+    __cfw_intern *styles = &__cfw.style_table;
+    __cfw_intern *graphemes = &__cfw.grapheme_table;
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    // Nothing can have been released since the last collection
+    if (styles->added == 0 && graphemes->added == 0)
+        return;
+
+    for (int id = 0; id < styles->count; id++)
+        styles->references[id] = min(styles->references[id], 0);
+    for (int id = 0; id < graphemes->count; id++)
+        graphemes->references[id] = min(graphemes->references[id], 0);
+
+    // Count what both buffers reference, along with the styles kept
+    // outside of them
+    size_t cells = (size_t)fb->width * (size_t)fb->height;
+    count_references(fb->back, cells);
+    count_references(fb->front, cells);
+
+    // The canvas keeps the styles of its cells until they are packed
+    // into the back buffer again
+    const __cfw_canvas *canvas = &__cfw.canvas;
+    size_t canvas_cells = (size_t)canvas->width * (size_t)canvas->height;
+    for (size_t i = 0; i < canvas_cells; i++)
+        styles->references[canvas->styles[i]]++;
+
+    styles->references[_CFW_STYLE_DEFAULT]++;
+    styles->references[__cfw.pen.style]++;
+    styles->references[__cfw.pinned_style]++;
+    styles->references[fb->style]++;
+
+    release_unreferenced(styles);
+    release_unreferenced(graphemes);
+}
+
+uint32_t _cfw_intern_style(const __cfw_style *style)
+{
+    __cfw_intern *table = &__cfw.style_table;
+    uint32_t hash = hash_bytes(style, sizeof(*style));
+
+    if (table->capacity > 0)
+    {
+        for (int id = table->buckets[hash & table->bucket_mask]; id >= 0; id = table->next[id])
+        {
+            if (table->hashes[id] == hash &&
+                memcmp(&__cfw.styles[id], style, sizeof(*style)) == 0)
+                return id;
+        }
+    }
+
+    int id = allocate_entry(table, (void **)&__cfw.styles, sizeof(__cfw_style), hash);
+    if (id < 0)
+        return _CFW_STYLE_DEFAULT;
+
+    __cfw.styles[id] = *style;
+    return id;
+}
+
+uint32_t _cfw_intern_grapheme(const char *text, int length)
+{
+    __cfw_intern *table = &__cfw.grapheme_table;
+    uint32_t hash = hash_bytes(text, length);
+
+    if (table->capacity > 0)
+    {
+        for (int id = table->buckets[hash & table->bucket_mask]; id >= 0; id = table->next[id])
+        {
+            const __cfw_grapheme *grapheme = &__cfw.graphemes[id];
+            if (table->hashes[id] == hash && grapheme->length == length &&
+                memcmp(grapheme->text, text, length) == 0)
+                return _CFW_GLYPH_GRAPHEME | id;
+        }
+    }
+
+    char *copy = malloc(length);
+    if (copy == NULL)
+    {
+        _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+        return _CFW_REPLACEMENT_CHARACTER;
+    }
+    memcpy(copy, text, length);
+
+    int id = allocate_entry(table, (void **)&__cfw.graphemes, sizeof(__cfw_grapheme), hash);
+    if (id < 0)
+    {
+        free(copy);
+        return _CFW_REPLACEMENT_CHARACTER;
+    }
+
+    __cfw.graphemes[id].text = copy;
+    __cfw.graphemes[id].length = length;
+    return _CFW_GLYPH_GRAPHEME | id;
+}
@@ -16,6 +16,9 @@
 #pragma once
 #endif
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "CFW/cfw.h"
 
 #define CFW_SWAP_POINTERS(x, y) \
@@ -54,14 +57,55 @@
         return;                                         \
     }
 
-#define substr(dest, res, start, end)                   \
-    memcpy(dest, &res[start], end); dest[end] = '\0';
-
 #define max(x,y) (((x) >= (y)) ? (x) : (y))
 #define min(x,y) (((x) <= (y)) ? (x) : (y))
 
-typedef struct __cfx_library    __cfx_library;
-typedef struct __cfw_region     __cfw_region;
+// How deep regions can be nested
+#define _CFW_REGION_STACK_SIZE  64
+
+// Cell attribute flags, the same as the public CFW_ATTR_* flags
+#define _CFW_ATTR_BOLD      0x01
+#define _CFW_ATTR_UNDERLINE 0x02
+#define _CFW_ATTR_REVERSE   0x04
+
+// Cell colors keep the kind of color in the top byte
+#define _CFW_COLOR_DEFAULT  0x00000000  // The console default
+#define _CFW_COLOR_PALETTE  0x01000000  // One of the 8 CFW colors
+#define _CFW_COLOR_RGB      0x02000000  // A 24-bit 0xRRGGBB color
+#define _CFW_COLOR_256      0x03000000  // One of the 256 console colors
+
+#define _CFW_COLOR_KIND(c)  ((c) & 0xFF000000)
+#define _CFW_COLOR_VALUE(c) ((c) & 0x00FFFFFF)
+
+// Drawn in place of invalid UTF-8 and characters that can't be drawn
+#define _CFW_REPLACEMENT_CHARACTER  0xFFFD
+
+// Glyph of the second cell covered by a double-width character. It
+// is outside of Unicode, so it never matches a codepoint.
+#define _CFW_GLYPH_CONTINUATION     0x110000
+
+// Glyphs with this bit set are the ids of interned graphemes, which
+// take more than one codepoint
+#define _CFW_GLYPH_GRAPHEME         0x80000000
+
+// Most bytes of UTF-8 kept of a grapheme. Marks past it are dropped.
+#define _CFW_GRAPHEME_MAX_SIZE      32
+
+// Id of the style with the default colors, which is always interned
+#define _CFW_STYLE_DEFAULT          0
+
+typedef struct __cfx_library        __cfx_library;
+typedef struct __cfw_region         __cfw_region;
+typedef struct __cfw_style          __cfw_style;
+typedef struct __cfw_grapheme       __cfw_grapheme;
+typedef struct __cfw_intern         __cfw_intern;
+typedef struct __cfw_cell           __cfw_cell;
+typedef struct __cfw_row            __cfw_row;
+typedef struct __cfw_framebuffer    __cfw_framebuffer;
+typedef struct __cfw_rasterizer     __cfw_rasterizer;
+typedef struct __cfw_edge           __cfw_edge;
+typedef struct __cfw_fill_span      __cfw_fill_span;
+typedef struct __cfw_canvas         __cfw_canvas;
 
 struct __cfw_region
 {
@@ -70,10 +114,214 @@ struct __cfw_region
     int width;
     int height;
 
-    // Pointer to next region in list
-    __cfw_region *next;
+    // Position of the region in the console
+    int offset_x;
+    int offset_y;
+
+    // Visible part of the region in the console, clipped by every
+    // enclosing region and the console itself. The right and bottom
+    // edges are exclusive.
+    int clip_left;
+    int clip_top;
+    int clip_right;
+    int clip_bottom;
+};
+
+struct __cfw_style
+{
+    uint32_t        fg;
+    uint32_t        bg;
+    int             attr;
+};
+
+struct __cfw_grapheme
+{
+    // UTF-8 encoded text, which isn't terminated
+    char            *text;
+    int             length;
+};
+
+// Bookkeeping of a table of interned values. Cells reference them by
+// id, so an id is only reused once no cell references it anymore.
+// The references are counted by going through every cell when the
+// table is collected.
+struct __cfw_intern
+{
+    // Hash chains of the entries. The number of buckets is a power
+    // of two.
+    int             *buckets;
+    int             bucket_mask;
+
+    // Next entry in the same chain, or the next free entry
+    int             *next;
+    uint32_t        *hashes;
+
+    // Number of cells referencing each entry, or -1 for free entries
+    int             *references;
+
+    int             count;
+    int             capacity;
+    int             free;
+
+    // Entries added since the table was last collected
+    int             added;
+};
+
+struct __cfw_cell
+{
+    // Unicode codepoint drawn in the cell, or an interned grapheme
+    uint32_t        glyph;
+
+    // Id of the interned style of the cell
+    uint32_t        style;
+};
+
+struct __cfw_row
+{
+    // The span of cells written since the last refresh. The row is
+    // clean when dirty_min is greater than dirty_max.
+    int             dirty_min;
+    int             dirty_max;
+
+    // Set when every cell of the row in the back buffer is blank
+    cfw__bool       blank;
+
+    // Set when cells of the front buffer row were found to be
+    // displayed wrong while the frame was being drawn
+    cfw__bool       stale;
+
+    // Hashes of the row in the back and the front buffer. The back
+    // hash is only updated on refresh.
+    uint64_t        hash;
+    uint64_t        front_hash;
+};
+
+// Span of cells a flood fill continues from, into the row dy away
+struct __cfw_fill_span
+{
+    int             left;
+    int             right;
+    int             y;
+    int             dy;
+};
+
+struct __cfw_framebuffer
+{
+    int             width;
+    int             height;
+
+    // Set when any row has been written since the last refresh
+    cfw__bool       dirty;
+
+    // Set when the console no longer displays the front buffer, and
+    // everything has to be drawn again
+    cfw__bool       invalid;
+
+    // Set when any row is stale
+    cfw__bool       stale;
+
+    // Damage information for each row of the back buffer
+    __cfw_row       *rows;
+
+    // The cells drawn to during the current frame
+    __cfw_cell      *back;
+
+    // The cells currently displayed in the console
+    __cfw_cell      *front;
+
+    // Style last passed to the platform. It stays set between runs
+    // and frames, so it's only passed again when it changes.
+    uint32_t        style;
+
+    // Scratch buffer runs of cells are encoded into as UTF-8, which
+    // takes at most _CFW_GRAPHEME_MAX_SIZE bytes per cell
+    char            *line;
+
+    // Open addressing table of the front row hashes, used to find
+    // rows that moved. Its size is a power of two.
+    struct
+    {
+        uint64_t    hash;
+        int         row;
+    }               *row_table;
+    int             row_table_size;
+
+    // Hash of a blank row
+    uint64_t        blank_hash;
+
+    // Stack of spans flood fills have yet to continue from, kept
+    // between fills
+    __cfw_fill_span *fill_stack;
+    int             fill_stack_size;
+    int             fill_stack_capacity;
+};
+
+// Edge of a filled polygon, crossing the rows from top up to bottom
+struct __cfw_edge
+{
+    int             top;
+    int             bottom;
+
+    // Where the edge crosses the current row is x + remainder / dy,
+    // and it moves by step + step_remainder / dy every row
+    long long       x;
+    long long       remainder;
+    long long       step;
+    long long       step_remainder;
+    long long       dy;
+
+    // 1 for edges going down, -1 for edges going up
+    int             winding;
+};
+
+// Plane of dots geometry is drawn to in the sub-cell canvas modes. It
+// covers the console, and the cells with new dots are packed into the
+// back buffer on refresh.
+struct __cfw_canvas
+{
+    int             mode;
+
+    // Number of dots across and down every cell
+    int             scale_x;
+    int             scale_y;
+
+    // Size of the canvas in cells
+    int             width;
+    int             height;
+
+    // One bit per dot, going right from the lowest bit of the first
+    // word of a row. Every row of dots starts a new word.
+    uint64_t        *dots;
+    size_t          row_words;
+
+    // One bit per cell with dots drawn since the last time the canvas
+    // was packed, laid out the same way as the dots
+    uint64_t        *changed;
+    size_t          changed_words;
+
+    // Set when any cell has changed
+    cfw__bool       dirty;
+
+    // Id of the style of the last dot drawn to each cell
+    uint32_t        *styles;
+
+    // The current region, scaled to dots
+    __cfw_region    region;
 };
 
+// Functions drawing the primitives in a polygon mode. They take
+// region coordinates, and don't check if CFW is initialized.
+struct __cfw_rasterizer
+{
+    void (*line)(int x1, int y1, int x2, int y2, uint32_t glyph);
+    void (*polyline)(const int *xy, size_t count, uint32_t glyph);
+    void (*triangle)(int x1, int y1, int x2, int y2, int x3, int y3, uint32_t glyph);
+    void (*quad)(int x1, int y1, int x2, int y2,
+                 int x3, int y3, int x4, int y4, uint32_t glyph);
+    void (*circle)(int x, int y, int radius, uint32_t glyph);
+    void (*ellipse)(int x, int y, int radius_x, int radius_y, uint32_t glyph);
+    void (*polygon)(const int *xy, size_t count, uint32_t glyph);
+};
 
 struct __cfx_library
 {
@@ -87,16 +335,57 @@ struct __cfx_library
     int             enabled_features;
 
     int             polygon_mode;
+    int             fill_rule;
+    int             dither_mode;
+
+    // Rasterizer of the polygon mode, so the primitives don't have to
+    // check the mode every time they are drawn
+    const __cfw_rasterizer *rasterizer;
 
     int             foreground_color;
     int             background_color;
 
+    // Template cell holding the current draw attributes, which are
+    // interned from the pen style whenever they change
+    __cfw_cell      pen;
+    __cfw_style     pen_style;
+
+    // Style a draw call is drawing with, which no cell may reference
+    // yet. It's kept when the tables are collected, like the pen.
+    uint32_t        pinned_style;
+
+    // Buffer strings are formatted into before they are drawn. It
+    // grows to fit the longest string formatted so far.
+    char            *format_buffer;
+    size_t          format_buffer_size;
+
+    // Memory rasterizers work in, like the edges of a polygon. It
+    // grows to fit the largest amount needed so far.
+    void            *scratch;
+    size_t          scratch_size;
+
+    // Styles and graphemes referenced by cells
+    __cfw_style     *styles;
+    __cfw_intern    style_table;
+    __cfw_grapheme  *graphemes;
+    __cfw_intern    grapheme_table;
+
     struct
     {
         cfw__charfun    char_callback;
     } callbacks;
 
-    __cfw_region    *region_head;
+    // Stack of the nested regions. The first entry is the entire
+    // console, and the current region is always at the top.
+    __cfw_region    regions[_CFW_REGION_STACK_SIZE + 1];
+    int             region_depth;
+
+    // Regions begun after the stack was full. They are ignored, but
+    // still have to be ended.
+    int             region_overflow;
+
+    __cfw_framebuffer framebuffer;
+    __cfw_canvas    canvas;
 };
 
 extern __cfx_library __cfw;
@@ -113,6 +402,52 @@ void _cfw_input_error(int errorcode, const char *fmt, ...);
 #endif
 
 void _cfw_poll_input(void);
+void _cfw_update_regions(void);
+const __cfw_rasterizer *_cfw_get_rasterizer(int mode);
+void *_cfw_get_scratch(size_t size);
+
+int         _cfw_color_to_256(uint32_t color);
+int         _cfw_color_to_16(uint32_t color);
+int         _cfw_color_to_8(uint32_t color);
+uint32_t    _cfw_color_from_256(int index);
+uint32_t    _cfw_color_from_16(int index);
+
+uint32_t    _cfw_utf8_decode(const char **str, const char *end);
+uint32_t    _cfw_utf8_decode_grapheme(const char **str, const char *end, int *width);
+int         _cfw_utf8_encode(uint32_t codepoint, char *out);
+int         _cfw_char_width(uint32_t codepoint);
+
+cfw__bool   _cfw_intern_init(void);
+void        _cfw_intern_free(void);
+void        _cfw_intern_collect(void);
+uint32_t    _cfw_intern_style(const __cfw_style *style);
+uint32_t    _cfw_intern_grapheme(const char *text, int length);
+
+cfw__bool   _cfw_framebuffer_resize(int width, int height);
+void        _cfw_framebuffer_free(void);
+void        _cfw_framebuffer_clear(void);
+void        _cfw_framebuffer_put_char(int x, int y, uint32_t glyph);
+void        _cfw_framebuffer_put_cell(int x, int y, uint32_t glyph, uint32_t style);
+void        _cfw_framebuffer_put_str(int x, int y, const char *str, size_t length, int left, int right);
+int         _cfw_framebuffer_put_run(int x, int y, const char *str, size_t length, uint32_t style,
+                                     int left, int right);
+void        _cfw_framebuffer_put_span(int x, int y, uint32_t glyph, int length);
+void        _cfw_framebuffer_put_cells(int x, int y, const __cfw_cell *cells, int length);
+void        _cfw_framebuffer_fill_rect(int x, int y, int width, int height, uint32_t glyph);
+void        _cfw_framebuffer_clear_rect(int x, int y, int width, int height);
+void        _cfw_framebuffer_flood_fill(int x, int y, uint32_t glyph,
+                                        int left, int top, int right, int bottom);
+const char *_cfw_framebuffer_encode_cells(const __cfw_cell *cells, int length);
+void        _cfw_framebuffer_invalidate(void);
+void        _cfw_framebuffer_invalidate_cells(int x, int y, int length);
+cfw__bool   _cfw_framebuffer_flush(void);
+
+cfw__bool   _cfw_canvas_resize(int width, int height);
+void        _cfw_canvas_free(void);
+void        _cfw_canvas_clear(void);
+const __cfw_region *_cfw_canvas_get_region(void);
+void        _cfw_canvas_put_span(int x, int y, int length);
+void        _cfw_canvas_pack(void);
 
 // ------------------------------------------------------------------
 // |                        CFW platform API                        |
@@ -123,15 +458,16 @@ void        _cfw_platform_terminate(void);
 void        _cfw_platform_refresh(void);
 cfw__bool   _cfw_platform_is_feature_supported(int feature);
 void        _cfw_platform_enable(int feature);
+int         _cfw_platform_get_color_count(void);
 void        _cfw_platform_get_console_size(int *width, int *height);
 
 int         _cfw_platform_get_char(void);
 int         _cfw_platform_get_char_no_halt(void);
 
+void        _cfw_platform_sync(void);
 void        _cfw_platform_clear(void);
-void        _cfw_platform_set_color(int fg_color, int bg_color);
-void        _cfw_platform_unset_color(int fg_color, int bg_color);
-void        _cfw_platform_draw_char(int x, int y, char c);
-void        _cfw_platform_draw_str(int x, int y, const char* str);
+void        _cfw_platform_set_attributes(uint32_t fg_color, uint32_t bg_color, int attributes);
+void        _cfw_platform_draw_cells(int x, int y, const __cfw_cell *cells, int length);
+cfw__bool   _cfw_platform_scroll(int top, int bottom, int lines);
 
 #endif /* __cfw_internal_h__ */
@@ -0,0 +1,444 @@
+/**
+ * @file ncurses_color.c
+ * @author Nicolai Frigaard
+ * @brief The ncurses color pair cache.
+ *
+ * Curses draws text with color pairs, of which the console only has
+ * a limited number. Pairs are initialized the first time a pair of
+ * colors is drawn, and the least recently used pair that isn't on
+ * the screen is redefined when they run out. When every pair is on
+ * the screen, the closest pair is drawn with instead, and the cells
+ * are drawn again once a pair leaves the screen.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ncurses.h>
+
+#include "internal.h"
+#include "ncurses_internal.h"
+
+typedef struct color_pair color_pair;
+
+struct color_pair
+{
+    short       fg;
+    short       bg;
+
+    // Neighbours in the list of pairs ordered by last use, or 0
+    int         newer;
+    int         older;
+
+    // Next pair in the same hash bucket, or 0
+    int         next;
+
+    // Number of cells on the screen drawn with the pair
+    int         visible;
+};
+
+// Pairs indexed by their pair number. Pair 0 holds the default colors
+// of the console and is never redefined, so its entry is unused.
+static color_pair *pairs = NULL;
+static int capacity = 0;
+static int count = 0;
+
+// Most and least recently used pairs
+static int newest = 0;
+static int oldest = 0;
+
+// Hash buckets holding the first pair of each chain. The number of
+// buckets is a power of two.
+static int *buckets = NULL;
+static int bucket_mask = 0;
+
+// The pair each cell of the screen was last drawn with. Cells drawn
+// with the closest pair instead of their own are stored negated.
+static short *screen = NULL;
+static int screen_width = 0;
+static int screen_height = 0;
+
+// Number of cells on the screen drawn with the closest pair
+static int approximated = 0;
+
+// Number of pairs that aren't on the screen
+static int hidden = 0;
+
+// Set when a pair has left the screen, so the cells drawn with the
+// closest pair may now get their own
+static cfw__bool pair_freed = CFW_FALSE;
+
+// Set when the console accepts -1 as its default colors
+static cfw__bool default_colors = CFW_FALSE;
+
+int *get_bucket(short fg, short bg)
+{
+    unsigned key = (unsigned)(fg + 1) << 16 | (unsigned short)(bg + 1);
+    return &buckets[(key * 2654435761u >> 8) & bucket_mask];
+}
+
+void unlink_pair(int id)
+{
+    color_pair *pair = &pairs[id];
+
+    if (pair->newer != 0)
+        pairs[pair->newer].older = pair->older;
+    else
+        newest = pair->older;
+
+    if (pair->older != 0)
+        pairs[pair->older].newer = pair->newer;
+    else
+        oldest = pair->newer;
+}
+
+void link_pair_newest(int id)
+{
+    pairs[id].newer = 0;
+    pairs[id].older = newest;
+
+    if (newest != 0)
+        pairs[newest].newer = id;
+    else
+        oldest = id;
+
+    newest = id;
+}
+
+void remove_from_bucket(int id)
+{
+    int *link = get_bucket(pairs[id].fg, pairs[id].bg);
+
+    while (*link != id)
+        link = &pairs[*link].next;
+
+    *link = pairs[id].next;
+}
+
+cfw__bool reset_screen(void)
+{
+    int width, height;
+    getmaxyx(stdscr, height, width);
+
+    if (width < 0)  width = 0;
+    if (height < 0) height = 0;
+
+    // A cleared screen only holds the default colors of pair 0
+    if (width != screen_width || height != screen_height || screen == NULL)
+    {
+        short *resized = malloc(((size_t)width * height + 1) * sizeof(short));
+        if (resized == NULL)
+        {
+            _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+            return CFW_FALSE;
+        }
+
+        free(screen);
+        screen = resized;
+        screen_width = width;
+        screen_height = height;
+    }
+
+    for (int i = 0; i < screen_width * screen_height; i++)
+        screen[i] = 0;
+    for (int id = 0; id <= capacity; id++)
+        pairs[id].visible = 0;
+
+    approximated = 0;
+    hidden = count;
+    pair_freed = CFW_FALSE;
+
+    return CFW_TRUE;
+}
+
+uint32_t get_pair_rgb(short color, short fallback)
+{
+    // Curses numbers the colors like the 256 color palette
+    return _cfw_color_from_256((color == -1) ? fallback : color);
+}
+
+int get_pair_distance(uint32_t fg1, uint32_t bg1, uint32_t fg2, uint32_t bg2)
+{
+    int distance = 0;
+    for (int shift = 0; shift < 24; shift += 8)
+    {
+        int fg = (int)((fg1 >> shift) & 0xFF) - (int)((fg2 >> shift) & 0xFF);
+        int bg = (int)((bg1 >> shift) & 0xFF) - (int)((bg2 >> shift) & 0xFF);
+        distance += fg * fg + bg * bg;
+    }
+    return distance;
+}
+
+void hide_cell(short cell)
+{
+    int id = abs(cell);
+
+    if (cell < 0)
+        approximated--;
+
+    // Pair 0 is never redefined
+    if (--pairs[id].visible == 0 && id != 0)
+    {
+        hidden++;
+        pair_freed = CFW_TRUE;
+    }
+}
+
+void redraw_approximated(void)
+{
+    // The framebuffer draws the cells again, which gives them their
+    // own pair now that there is one to spare. The pair may have
+    // been shown again already, by the cells drawn over it.
+    if (approximated > 0 && hidden > 0)
+    {
+        for (int y = 0; y < screen_height; y++)
+        {
+            const short *row = &screen[y * screen_width];
+            for (int x = 0; x < screen_width; )
+            {
+                if (row[x] >= 0)
+                {
+                    x++;
+                    continue;
+                }
+
+                int start = x;
+                while (x < screen_width && row[x] < 0)
+                    x++;
+                _cfw_framebuffer_invalidate_cells(start, y, x - start);
+            }
+        }
+    }
+
+    pair_freed = CFW_FALSE;
+}
+
+short *get_screen_cells(int x, int y, int *length)
+{
+    if (screen == NULL || y < 0 || y >= screen_height)
+    {
+        *length = 0;
+        return screen;
+    }
+
+    if (x < 0)
+    {
+        *length += x;
+        x = 0;
+    }
+    *length = max(min(*length, screen_width - x), 0);
+
+    return &screen[y * screen_width + x];
+}
+
+int find_closest_pair(short fg, short bg)
+{
+    uint32_t fg_rgb = get_pair_rgb(fg, COLOR_WHITE);
+    uint32_t bg_rgb = get_pair_rgb(bg, COLOR_BLACK);
+
+    int best = 0, best_distance = -1;
+    for (int id = 1; id <= count; id++)
+    {
+        int distance = get_pair_distance(fg_rgb, bg_rgb,
+                                         get_pair_rgb(pairs[id].fg, COLOR_WHITE),
+                                         get_pair_rgb(pairs[id].bg, COLOR_BLACK));
+        if (best_distance < 0 || distance < best_distance)
+        {
+            best = id;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+// ------------------------------------------------------------------
+// |                   CFW internal platform API                    |
+// ------------------------------------------------------------------
+
+cfw__bool _cfw_platform_ncurses_init_pairs(cfw__bool use_default)
+{
+    _cfw_platform_ncurses_free_pairs();
+
+    // Pair numbers have to fit in a short
+    capacity = min(COLOR_PAIRS - 1, 32767);
+    if (capacity < 0)
+        capacity = 0;
+
+    int bucket_count = 1;
+    while (bucket_count < capacity)
+        bucket_count *= 2;
+
+    pairs   = calloc((size_t)capacity + 1, sizeof(color_pair));
+    buckets = calloc(bucket_count, sizeof(int));
+
+    if (pairs == NULL || buckets == NULL)
+    {
+        _cfw_platform_ncurses_free_pairs();
+        _cfw_input_error(CFW_OUT_OF_MEMORY, NULL);
+        return CFW_FALSE;
+    }
+
+    bucket_mask = bucket_count - 1;
+    default_colors = use_default;
+
+    // Nothing drawn before the colors were enabled uses a pair
+    if (!reset_screen())
+    {
+        _cfw_platform_ncurses_free_pairs();
+        return CFW_FALSE;
+    }
+
+    return CFW_TRUE;
+}
+
+void _cfw_platform_ncurses_free_pairs(void)
+{
+    free(pairs);
+    free(buckets);
+    free(screen);
+
+    pairs = NULL;
+    buckets = NULL;
+    screen = NULL;
+    capacity = count = 0;
+    approximated = hidden = 0;
+    newest = oldest = 0;
+    bucket_mask = 0;
+    screen_width = screen_height = 0;
+}
+
+short _cfw_platform_ncurses_get_pair(short fg, short bg, cfw__bool *approximate)
+{
+    *approximate = CFW_FALSE;
+
+    // Without default colors, the default is white text on black
+    if (!default_colors)
+    {
+        if (fg == -1) fg = COLOR_WHITE;
+        if (bg == -1) bg = COLOR_BLACK;
+    }
+
+    if ((fg == -1 && bg == -1) || capacity == 0)
+        return 0;
+
+    int *bucket = get_bucket(fg, bg);
+    for (int id = *bucket; id != 0; id = pairs[id].next)
+    {
+        if (pairs[id].fg == fg && pairs[id].bg == bg)
+        {
+            unlink_pair(id);
+            link_pair_newest(id);
+            return id;
+        }
+    }
+
+    int id;
+    if (count < capacity)
+    {
+        id = ++count;
+        hidden++;
+    }
+    else
+    {
+        // Curses changes the colors of the text already drawn with a
+        // redefined pair, so only a pair that isn't on the screen can
+        // be redefined
+        id = oldest;
+        while (id != 0 && pairs[id].visible > 0)
+            id = pairs[id].newer;
+
+        // Every pair is on the screen, so the closest one has to do
+        // until some of them are drawn over
+        if (id == 0)
+        {
+            *approximate = CFW_TRUE;
+            return find_closest_pair(fg, bg);
+        }
+
+        unlink_pair(id);
+        remove_from_bucket(id);
+    }
+
+    init_pair(id, fg, bg);
+
+    pairs[id].fg = fg;
+    pairs[id].bg = bg;
+    pairs[id].next = *bucket;
+    *bucket = id;
+    link_pair_newest(id);
+
+    return id;
+}
+
+void _cfw_platform_ncurses_hide_cells(int x, int y, int length)
+{
+    short *cells = get_screen_cells(x, y, &length);
+    for (int i = 0; i < length; i++)
+    {
+        hide_cell(cells[i]);
+        cells[i] = 0;
+    }
+}
+
+void _cfw_platform_ncurses_show_pair(int x, int y, int length, short pair, cfw__bool approximate)
+{
+    short *cells = get_screen_cells(x, y, &length);
+    if (length == 0)
+        return;
+
+    // The cells were hidden before their pair was picked, so they
+    // hold no pair
+    for (int i = 0; i < length; i++)
+        cells[i] = approximate ? -pair : pair;
+
+    if (pairs[pair].visible == 0 && pair != 0)
+        hidden--;
+    pairs[pair].visible += length;
+    approximated += approximate ? length : 0;
+
+    if (pair_freed)
+        redraw_approximated();
+}
+
+void _cfw_platform_ncurses_scroll_pairs(int top, int bottom, int lines)
+{
+    if (screen == NULL || top < 0 || bottom >= screen_height || top > bottom)
+        return;
+
+    int height = bottom - top + 1;
+    int shift = min(abs(lines), height);
+    short *region = &screen[top * screen_width];
+
+    // The rows scrolled out of the region are gone
+    short *gone = (lines > 0) ? region : &region[(height - shift) * screen_width];
+    for (int i = 0; i < shift * screen_width; i++)
+        hide_cell(gone[i]);
+
+    if (lines > 0)
+        memmove(region, &region[shift * screen_width],
+                (size_t)(height - shift) * screen_width * sizeof(short));
+    else
+        memmove(&region[shift * screen_width], region,
+                (size_t)(height - shift) * screen_width * sizeof(short));
+
+    // The rows scrolled in are blank
+    short *blank = (lines > 0) ? &region[(height - shift) * screen_width] : region;
+    for (int i = 0; i < shift * screen_width; i++)
+        blank[i] = 0;
+}
+
+void _cfw_platform_ncurses_update_pairs(void)
+{
+    // Scrolling may have freed pairs after the last cells of the
+    // frame were drawn
+    if (pair_freed)
+        redraw_approximated();
+}
+
+void _cfw_platform_ncurses_hide_pairs(void)
+{
+    if (pairs != NULL)
+        reset_screen();
+}
@@ -9,49 +9,188 @@
  * @copyright Copyright (c) 2020
  */
 
+#define _XOPEN_SOURCE 700
+
 #include <unistd.h>
+#include <wchar.h>
 
 #include <ncurses.h>
 
 #include "internal.h"
 #include "ncurses_internal.h"
 
+// The attributes the cells are currently drawn with, and whether
+// their pair is only the closest one to their colors
+static short current_fg = -1;
+static short current_bg = -1;
+static attr_t current_attributes = A_NORMAL;
+static short current_pair = 0;
+static cfw__bool current_approximate = CFW_FALSE;
+
+short get_ncurses_color_id(int color)
+{
+    // CFW orders the colors like the Windows console, not like ANSI
+    static const short colors[8] =
+    {
+        COLOR_BLACK, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN,
+        COLOR_RED, COLOR_MAGENTA, COLOR_YELLOW, COLOR_WHITE
+    };
+
+    // The bright colors follow the normal ones in the same order
+    return colors[color & 7] + ((color & 8) ? 8 : 0);
+}
+
+short get_color(uint32_t color, cfw__bool foreground, int *attributes)
+{
+    switch (_CFW_COLOR_KIND(color))
+    {
+    case _CFW_COLOR_PALETTE:
+        return get_ncurses_color_id(_CFW_COLOR_VALUE(color));
+
+    case _CFW_COLOR_RGB:
+        if (COLORS >= 256)
+            return _cfw_color_to_256(_CFW_COLOR_VALUE(color));
+
+        if (COLORS >= 16)
+            return get_ncurses_color_id(_cfw_color_to_16(_CFW_COLOR_VALUE(color)));
+
+        // Only 8 colors are available, but the foreground can be
+        // made brighter by drawing it bold
+        if (foreground)
+        {
+            int basic = _cfw_color_to_16(_CFW_COLOR_VALUE(color));
+            if (basic & 8)
+                *attributes |= _CFW_ATTR_BOLD;
+            return get_ncurses_color_id(basic & 7);
+        }
+        return get_ncurses_color_id(_cfw_color_to_8(_CFW_COLOR_VALUE(color)));
+
+    case _CFW_COLOR_256:
+        return _CFW_COLOR_VALUE(color);
+
+    default:
+        return -1;
+    }
+}
+
+void update_pair(void)
+{
+    current_pair = _cfw_platform_ncurses_get_pair(current_fg, current_bg, &current_approximate);
+
+    // Replace all attributes in a single call
+    attr_set(current_attributes, current_pair, NULL);
+}
+
+void draw_grapheme(uint32_t glyph)
+{
+    const __cfw_grapheme *grapheme = &__cfw.graphemes[glyph & ~_CFW_GLYPH_GRAPHEME];
+    const char *text = grapheme->text;
+    const char *end = text + grapheme->length;
+
+    // Curses gives every codepoint the width wcwidth() reports, so
+    // anything after the first codepoint that would take up columns
+    // of its own, like skin tones or joined emoji, is left out to
+    // keep the columns aligned
+    char out[_CFW_GRAPHEME_MAX_SIZE + 1];
+    int length = 0;
+
+    for (cfw__bool first = CFW_TRUE; text < end; first = CFW_FALSE)
+    {
+        uint32_t codepoint = _cfw_utf8_decode(&text, end);
+        if (first || wcwidth((wchar_t)codepoint) == 0)
+            length += _cfw_utf8_encode(codepoint, &out[length]);
+    }
+    out[length] = '\0';
+
+    addstr(out);
+}
+
 // ------------------------------------------------------------------
 // |                        CFW platform API                        |
 // ------------------------------------------------------------------
 
-void _cfw_platform_clear(void)
+void _cfw_platform_sync(void)
 {
-    clear();            // Clear the content of the console
+    // Curses restores the console itself when the application is
+    // stopped and continued
 }
 
-void _cfw_platform_set_color(int fg_color, int bg_color)
+void _cfw_platform_clear(void)
 {
-    // Set color pair
-    attron(COLOR_PAIR(_cfw_platform_ncurses_colornum(fg_color, bg_color)));
+    clear();            // Clear the content of the console
 
-    // Check if text is bold
-    if (_cfw_platform_ncurses_is_bold(fg_color))
-        attron(A_BOLD);
+    // None of the color pairs are visible anymore
+    _cfw_platform_ncurses_hide_pairs();
 }
 
-void _cfw_platform_unset_color(int fg_color, int bg_color)
+void _cfw_platform_set_attributes(uint32_t fg_color, uint32_t bg_color, int attributes)
 {
-    // Disable color pair
-    attroff(COLOR_PAIR(_cfw_platform_ncurses_colornum(fg_color, bg_color)));
-    use_default_colors();
+    short fg = get_color(fg_color, CFW_TRUE, &attributes);
+    short bg = get_color(bg_color, CFW_FALSE, &attributes);
+
+    attr_t curses_attributes = A_NORMAL;
+    if (attributes & _CFW_ATTR_BOLD)
+        curses_attributes |= A_BOLD;
+    if (attributes & _CFW_ATTR_UNDERLINE)
+        curses_attributes |= A_UNDERLINE;
+    if (attributes & _CFW_ATTR_REVERSE)
+        curses_attributes |= A_REVERSE;
 
-    // Check if text was bold
-    if (_cfw_platform_ncurses_is_bold(fg_color))
-        attroff(A_BOLD);
+    current_fg = fg;
+    current_bg = bg;
+    current_attributes = curses_attributes;
+    update_pair();
 }
 
-void _cfw_platform_draw_char(int x, int y, char c)
+void _cfw_platform_draw_cells(int x, int y, const __cfw_cell *cells, int length)
 {
-    mvaddch(y, x, c);
+    // Keep track of the pairs on the screen, so none of them are
+    // redefined while they are visible. The cells drawn over may
+    // have been the last ones of their pair.
+    _cfw_platform_ncurses_hide_cells(x, y, length);
+
+    // A pair may have left the screen since the closest one was
+    // picked, and CFW only sets the attributes when they change
+    if (current_approximate)
+        update_pair();
+
+    _cfw_platform_ncurses_show_pair(x, y, length, current_pair, current_approximate);
+
+    // Curses decodes the UTF-8 text itself, as long as the locale
+    // uses UTF-8
+    if (length == 1 && cells->glyph < 0x80)
+    {
+        mvaddch(y, x, cells->glyph);
+        return;
+    }
+
+    move(y, x);
+
+    int start = 0;
+    for (int i = 0; i <= length; i++)
+    {
+        if (i < length && !(cells[i].glyph & _CFW_GLYPH_GRAPHEME))
+            continue;
+
+        if (start < i)
+            addstr(_cfw_framebuffer_encode_cells(&cells[start], i - start));
+        if (i < length)
+            draw_grapheme(cells[i].glyph);
+
+        start = i + 1;
+    }
 }
 
-void _cfw_platform_draw_str(int x, int y, const char* str)
+cfw__bool _cfw_platform_scroll(int top, int bottom, int lines)
 {
-    mvprintw(y, x, str);
-}
\ No newline at end of file
+    // Scroll the window content, and let Curses figure out how to
+    // send it to the console
+    scrollok(stdscr, TRUE);
+    wsetscrreg(stdscr, top, bottom);
+    wscrl(stdscr, lines);
+    _cfw_platform_ncurses_scroll_pairs(top, bottom, lines);
+    wsetscrreg(stdscr, 0, LINES - 1);
+    scrollok(stdscr, FALSE);
+
+    return CFW_TRUE;
+}
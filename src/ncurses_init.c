@@ -9,87 +9,28 @@
  * @copyright Copyright (c) 2020
  */
 
+#include <locale.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <ncurses.h>
 
 #include "internal.h"
 #include "ncurses_internal.h"
 
-short get_ncurses_color_id(int color)
-{
-    switch (color)
-    {
-    case 0:
-        return COLOR_BLACK;
-    case 1:
-        return COLOR_BLUE;
-    case 2:
-        return COLOR_GREEN;
-    case 3:
-        return COLOR_CYAN;
-    case 4:
-        return COLOR_RED;
-    case 5:
-        return COLOR_MAGENTA;
-    case 6:
-        return COLOR_YELLOW;
-    case 7:
-        return COLOR_WHITE;
-
-    default:
-        return COLOR_WHITE;
-    }
-}
-
-void create_color_pairs()
-{
-    // Generate all possible color configurations
-    for (int bg_color = CFW_BLACK; bg_color <= CFW_WHITE; bg_color++)
-    {
-        for (int fg_color = CFW_BLACK; fg_color <= CFW_WHITE; fg_color++)
-        {
-            int id = _cfw_platform_ncurses_colornum(fg_color, bg_color);
-            init_pair(id, get_ncurses_color_id(fg_color),
-                          get_ncurses_color_id(bg_color));
-        }
-    }
-}
-
-// ------------------------------------------------------------------
-// |                   CFW internal platform API                    |
-// ------------------------------------------------------------------
-
-int _cfw_platform_ncurses_colornum(int foreground, int background)
-{
-    // 10001111 = Bold white, black background = 143
-    // ||||||||
-    // |||||--- Foreground color
-    // ||||---- Bold (not set here)
-    // |------- Background color
-    // -------- Bonus bit to assure that 0 is never returned
-
-    int B, bbb, ffff;
-
-    B = 1 << 7;
-    bbb = (7 & background) << 4;
-    ffff = 7 & foreground;
-
-    return (B | bbb | ffff);
-}
-
-cfw__bool _cfw_platform_ncurses_is_bold(int color)
-{
-    int i = 1 << 3;
-    return (i & color);
-}
-
 // ------------------------------------------------------------------
 // |                        CFW platform API                        |
 // ------------------------------------------------------------------
 
 cfw__bool _cfw_platform_init(void)
 {
+    // Curses only draws UTF-8 text when the locale uses it. Take the
+    // character encoding from the environment, unless the application
+    // has set a locale already.
+    const char *locale = setlocale(LC_CTYPE, NULL);
+    if (locale == NULL || strcmp(locale, "C") == 0)
+        setlocale(LC_CTYPE, "");
+
     initscr();              // Initialize the window
     noecho();               // Don't echo any keypress
     curs_set(FALSE);        // Don't display a cursor
@@ -107,10 +48,12 @@ cfw__bool _cfw_platform_init(void)
 void _cfw_platform_terminate(void)
 {
     endwin();           // Restore window to normal behavior
+    _cfw_platform_ncurses_free_pairs();
 }
 
 void _cfw_platform_refresh(void)
 {
+    _cfw_platform_ncurses_update_pairs();
     refresh();          // Refresh the window and update content
 }
 
@@ -134,7 +77,10 @@ void _cfw_platform_enable(int feature)
     {
     case CFW_COLORS:
         start_color();
-        create_color_pairs();
+
+        // Pairs are only initialized once they are drawn with. Colors
+        // of -1 are the default colors when the console supports it.
+        _cfw_platform_ncurses_init_pairs(use_default_colors() == OK);
         break;
 
     default:
@@ -142,6 +88,13 @@ void _cfw_platform_enable(int feature)
     }
 }
 
+int _cfw_platform_get_color_count(void)
+{
+    // RGB colors are drawn as one of the 256 colors at best, and with
+    // fewer than 256 colors, only the basic colors are used
+    return (COLORS >= 256) ? 256 : 16;
+}
+
 void _cfw_platform_get_console_size(int *width, int *height)
 {
     getmaxyx(stdscr, *height, *width);
@@ -9,7 +9,13 @@
 // |                   CFW internal platform API                    |
 // ------------------------------------------------------------------
 
-int         _cfw_platform_ncurses_colornum(int foreground, int background);
-cfw__bool   _cfw_platform_ncurses_is_bold(int color);
+cfw__bool   _cfw_platform_ncurses_init_pairs(cfw__bool use_default);
+void        _cfw_platform_ncurses_free_pairs(void);
+short       _cfw_platform_ncurses_get_pair(short fg, short bg, cfw__bool *approximate);
+void        _cfw_platform_ncurses_hide_cells(int x, int y, int length);
+void        _cfw_platform_ncurses_show_pair(int x, int y, int length, short pair, cfw__bool approximate);
+void        _cfw_platform_ncurses_scroll_pairs(int top, int bottom, int lines);
+void        _cfw_platform_ncurses_update_pairs(void);
+void        _cfw_platform_ncurses_hide_pairs(void);
 
 #endif /* __cfw_ncurses_internal_h__ */
\ No newline at end of file
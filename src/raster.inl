@@ -0,0 +1,220 @@
+/**
+ * @file raster.inl
+ * @author Nicolai Frigaard
+ * @brief Template of the outline and filled rasterizers.
+ *
+ * This file is included by draw.c once for every polygon mode that
+ * draws more than the points of a polygon. The includer defines
+ * RASTER_NAME(name) to name the functions of the mode, and
+ * RASTER_FILL to 1 when the interior is drawn, or 0 when only the
+ * outline is. Both are undefined again at the end of the file.
+ *
+ * The functions take region coordinates and don't check if CFW is
+ * initialized, and make up the rasterizer of the mode.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#if !defined(RASTER_NAME) || !defined(RASTER_FILL)
+    #error "RASTER_NAME and RASTER_FILL have to be defined"
+#endif
+
+void RASTER_NAME(raster_line)(int x1, int y1, int x2, int y2, uint32_t glyph)
+{
+    // For a line, FILL and LINES give the same result
+    draw_line(x1, y1, x2, y2, glyph, CFW_FALSE);
+}
+
+void RASTER_NAME(raster_polyline)(const int *xy, size_t count, uint32_t glyph)
+{
+    // A single point is still drawn
+    if (count == 1)
+        draw_line(xy[0], xy[1], xy[0], xy[1], glyph, CFW_FALSE);
+
+    // Every line starts where the previous one ended, so only the
+    // first line draws its first tile
+    for (size_t i = 1; i < count; i++)
+    {
+        const int *from = &xy[(i - 1) * 2];
+        const int *to = &xy[i * 2];
+        draw_line(from[0], from[1], to[0], to[1], glyph, i > 1);
+    }
+}
+
+void RASTER_NAME(raster_triangle)(int x1, int y1, int x2, int y2,
+                                  int x3, int y3, uint32_t glyph)
+{
+#if RASTER_FILL
+    draw_triangle_fill(x1, y1, x2, y2, x3, y3, glyph);
+#else
+    draw_line(x1, y1, x2, y2, glyph, CFW_FALSE);
+    draw_line(x2, y2, x3, y3, glyph, CFW_TRUE);
+    draw_line(x3, y3, x1, y1, glyph, CFW_TRUE);
+#endif
+}
+
+void RASTER_NAME(raster_quad)(int x1, int y1, int x2, int y2,
+                              int x3, int y3, int x4, int y4, uint32_t glyph)
+{
+#if RASTER_FILL
+    int xy[8] = { x1, y1, x2, y2, x3, y3, x4, y4 };
+
+    // Splitting the quad into two triangles only works when it's
+    // convex
+    if (is_convex(xy, 4))
+    {
+        draw_triangle_fill(x1, y1, x2, y2, x3, y3, glyph);
+        draw_triangle_fill(x1, y1, x3, y3, x4, y4, glyph);
+    }
+    else
+        fill_polygon(xy, 4, glyph);
+#else
+    draw_line(x1, y1, x2, y2, glyph, CFW_FALSE);
+    draw_line(x2, y2, x3, y3, glyph, CFW_TRUE);
+    draw_line(x3, y3, x4, y4, glyph, CFW_TRUE);
+    draw_line(x4, y4, x1, y1, glyph, CFW_TRUE);
+#endif
+}
+
+void RASTER_NAME(raster_polygon)(const int *xy, size_t count, uint32_t glyph)
+{
+#if RASTER_FILL
+    fill_polygon(xy, count, glyph);
+#else
+    RASTER_NAME(raster_polyline)(xy, count, glyph);
+
+    // Close the outline
+    if (count > 2)
+    {
+        const int *last = &xy[(count - 1) * 2];
+        draw_line(last[0], last[1], xy[0], xy[1], glyph, CFW_TRUE);
+    }
+#endif
+}
+
+// DISCLAIMER: The circle rasterization code is from the
+// OneLoneCoders olcConsoleGameEngine project.
+//
+// Repository:
+// https://github.com/OneLoneCoder/videos/blob/master/olcConsoleGameEngine.h
+
+void RASTER_NAME(raster_circle)(int x, int y, int radius, uint32_t glyph)
+{
+    int tile_x = 0;
+    int tile_y = radius;
+    int f = 3 - 2 * radius;
+
+    if (!radius) return;
+
+    // Skip circles that are entirely outside of the region
+    if (!is_box_visible(x - radius, y - radius, x + radius, y + radius))
+        return;
+
+    while (tile_y >= tile_x)
+    {
+#if RASTER_FILL
+        // Every row at tile_x is only reached once, and is as wide
+        // as the circle gets in that row
+        draw_mirrored_rows(x, y, tile_x, tile_y, glyph);
+
+        if (f < 0) f += 4 * tile_x++ + 6;
+        else
+        {
+            // The rows at tile_y are done growing when tile_y moves
+            // on, unless tile_x reaches them and fills them instead
+            if (tile_y > tile_x)
+                draw_mirrored_rows(x, y, tile_y, tile_x, glyph);
+
+            f += 4 * (tile_x++ - tile_y--) + 10;
+        }
+#else
+        plot(x - tile_x, y - tile_y, glyph);
+        plot(x - tile_y, y - tile_x, glyph);
+        plot(x + tile_y, y - tile_x, glyph);
+        plot(x + tile_x, y - tile_y, glyph);
+        plot(x - tile_x, y + tile_y, glyph);
+        plot(x - tile_y, y + tile_x, glyph);
+        plot(x + tile_y, y + tile_x, glyph);
+        plot(x + tile_x, y + tile_y, glyph);
+        if (f < 0) f += 4 * tile_x++ + 6;
+        else f += 4 * (tile_x++ - tile_y--) + 10;
+#endif
+    }
+}
+
+// End of OneLoneCoder code
+
+// The ellipse rasterization is based on the algorithm by Alois
+// Zingl, from "A Rasterizing Algorithm for Drawing Curves".
+//
+// Website:
+// http://members.chello.at/easyfilter/bresenham.html
+
+void RASTER_NAME(raster_ellipse)(int x, int y, int radius_x, int radius_y, uint32_t glyph)
+{
+    // Skip ellipses that are entirely outside of the region
+    if (!is_box_visible(x - radius_x, y - radius_y, x + radius_x, y + radius_y))
+        return;
+
+    // Walk the left half of the upper quadrant, from the widest row
+    // up to the top, and mirror it to the other quadrants
+    long long a2 = (long long)radius_x * radius_x;
+    long long b2 = (long long)radius_y * radius_y;
+    int tile_x = -radius_x;
+    int tile_y = 0;
+#if RASTER_FILL
+    int filled_row = -1;
+#endif
+    long long error = tile_x * (2 * b2 + tile_x) + b2;
+
+    do
+    {
+#if RASTER_FILL
+        // The first tile of a row is the widest, so every row is
+        // filled exactly once
+        if (tile_y != filled_row)
+        {
+            draw_mirrored_rows(x, y, tile_y, -tile_x, glyph);
+            filled_row = tile_y;
+        }
+#else
+        plot(x - tile_x, y + tile_y, glyph);
+        plot(x + tile_x, y + tile_y, glyph);
+        plot(x + tile_x, y - tile_y, glyph);
+        plot(x - tile_x, y - tile_y, glyph);
+#endif
+
+        long long e2 = 2 * error;
+        if (e2 >= (tile_x * 2 + 1) * b2)
+        {
+            tile_x++;
+            error += (tile_x * 2 + 1) * b2;
+        }
+        if (e2 <= (tile_y * 2 + 1) * a2)
+        {
+            tile_y++;
+            error += (tile_y * 2 + 1) * a2;
+        }
+    } while (tile_x <= 0);
+
+    // Flat ellipses stop too early, so finish their tips
+    while (tile_y++ < radius_y)
+    {
+        plot(x, y + tile_y, glyph);
+        plot(x, y - tile_y, glyph);
+    }
+}
+
+const __cfw_rasterizer RASTER_NAME(rasterizer) =
+{
+    RASTER_NAME(raster_line),
+    RASTER_NAME(raster_polyline),
+    RASTER_NAME(raster_triangle),
+    RASTER_NAME(raster_quad),
+    RASTER_NAME(raster_circle),
+    RASTER_NAME(raster_ellipse),
+    RASTER_NAME(raster_polygon)
+};
+
+#undef RASTER_NAME
+#undef RASTER_FILL
@@ -0,0 +1,194 @@
+/**
+ * @file unicode.c
+ * @author Nicolai Frigaard
+ * @brief Implementation of the UTF-8 and display width handling.
+ *
+ * Strings are UTF-8 encoded, and cells hold Unicode codepoints, or
+ * interned graphemes when a character is followed by marks or joined
+ * to others. The number of columns a codepoint takes up in the
+ * console is looked up in a table generated by
+ * tools/unicode_width.py.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <string.h>
+
+#include "internal.h"
+#include "unicode_width.h"
+
+#define ZERO_WIDTH_JOINER 0x200D
+
+cfw__bool is_regional_indicator(uint32_t codepoint)
+{
+    return codepoint >= 0x1F1E6 && codepoint <= 0x1F1FF;
+}
+
+cfw__bool is_grapheme_extender(uint32_t codepoint)
+{
+    // Combining marks, joiners and variation selectors have no width
+    // of their own, unlike the control characters. Skin tone
+    // modifiers are wide, but only change the emoji before them.
+    if (codepoint >= 0x1F3FB && codepoint <= 0x1F3FF)
+        return CFW_TRUE;
+
+    return codepoint >= 0xA0 && _cfw_char_width(codepoint) == 0;
+}
+
+// ------------------------------------------------------------------
+// |                        CFW internal API                        |
+// ------------------------------------------------------------------
+
+uint32_t _cfw_utf8_decode(const char **str, const char *end)
+{
+    const unsigned char *s = (const unsigned char *)*str;
+    uint32_t codepoint = s[0];
+
+    // ASCII is the common case
+    if (codepoint < 0x80)
+    {
+        *str += 1;
+        return codepoint;
+    }
+
+    int length;
+    uint32_t minimum;
+    if ((codepoint & 0xE0) == 0xC0)
+    {
+        length = 2;
+        minimum = 0x80;
+        codepoint &= 0x1F;
+    }
+    else if ((codepoint & 0xF0) == 0xE0)
+    {
+        length = 3;
+        minimum = 0x800;
+        codepoint &= 0x0F;
+    }
+    else if ((codepoint & 0xF8) == 0xF0)
+    {
+        length = 4;
+        minimum = 0x10000;
+        codepoint &= 0x07;
+    }
+    else
+    {
+        // A continuation byte without a leading byte
+        *str += 1;
+        return _CFW_REPLACEMENT_CHARACTER;
+    }
+
+    for (int i = 1; i < length; i++)
+    {
+        // Truncated sequences are replaced, and decoding resumes at
+        // the byte that ended them
+        if ((const char *)&s[i] >= end || (s[i] & 0xC0) != 0x80)
+        {
+            *str += i;
+            return _CFW_REPLACEMENT_CHARACTER;
+        }
+
+        codepoint = (codepoint << 6) | (s[i] & 0x3F);
+    }
+
+    *str += length;
+
+    // Overlong encodings, surrogates and codepoints past the end of
+    // Unicode are invalid
+    if (codepoint < minimum || codepoint > 0x10FFFF ||
+        (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+        return _CFW_REPLACEMENT_CHARACTER;
+
+    return codepoint;
+}
+
+int _cfw_utf8_encode(uint32_t codepoint, char *out)
+{
+    if (codepoint < 0x80)
+    {
+        out[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800)
+    {
+        out[0] = (char)(0xC0 | (codepoint >> 6));
+        out[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (codepoint >> 12));
+        out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+
+    out[0] = (char)(0xF0 | (codepoint >> 18));
+    out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+uint32_t _cfw_utf8_decode_grapheme(const char **str, const char *end, int *width)
+{
+    uint32_t base = _cfw_utf8_decode(str, end);
+    *width = _cfw_char_width(base);
+
+    // Characters without a width of their own can't start a grapheme
+    if (*width == 0)
+        return base;
+
+    char text[_CFW_GRAPHEME_MAX_SIZE];
+    int length = _cfw_utf8_encode(base, text);
+    int codepoints = 1;
+    cfw__bool joined = CFW_FALSE;
+
+    while (*str < end)
+    {
+        const char *next = *str;
+        uint32_t codepoint = _cfw_utf8_decode(&next, end);
+
+        // A character joined to the previous one by a zero width
+        // joiner is part of the same emoji, and two regional
+        // indicators make up a flag
+        if (joined && codepoint >= 0x80 && _cfw_char_width(codepoint) > 0)
+            joined = CFW_FALSE;
+        else if (codepoints == 1 && is_regional_indicator(base) &&
+                 is_regional_indicator(codepoint))
+            *width = 2;
+        else if (is_grapheme_extender(codepoint))
+            joined = (codepoint == ZERO_WIDTH_JOINER);
+        else
+            break;
+
+        *str = next;
+
+        // Whatever doesn't fit is left out
+        char bytes[4];
+        int size = _cfw_utf8_encode(codepoint, bytes);
+        if (length + size <= _CFW_GRAPHEME_MAX_SIZE)
+        {
+            memcpy(&text[length], bytes, size);
+            length += size;
+            codepoints++;
+        }
+    }
+
+    if (codepoints == 1)
+        return base;
+
+    return _cfw_intern_grapheme(text, length);
+}
+
+int _cfw_char_width(uint32_t codepoint)
+{
+    if (codepoint > 0x10FFFF)
+        return 1;
+
+    // Every codepoint has two bits in the block it belongs to
+    const unsigned char *block = width_stage2[width_stage1[codepoint / UNICODE_WIDTH_BLOCK_SIZE]];
+    int offset = codepoint % UNICODE_WIDTH_BLOCK_SIZE;
+
+    return (block[offset >> 2] >> ((offset & 3) * 2)) & 3;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file test.c
+ * @author Nicolai Frigaard
+ * @brief Implementation of the helpers shared by the CFW tests.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+    #include <util.h>
+#else
+    #include <pty.h>
+#endif
+
+#include "test.h"
+
+FILE *test_output;
+int test_failures;
+
+int test_run(void (*test)(void))
+{
+    return test_run_with_term(test, "xterm-256color");
+}
+
+int test_run_with_term(void (*test)(void), const char *term)
+{
+    // The console of the child is the pseudo terminal, so failures
+    // are written to a copy of the standard error of the runner
+    int output = dup(STDERR_FILENO);
+    struct winsize size = { 24, 80, 0, 0 };
+
+    int terminal;
+    pid_t pid = forkpty(&terminal, NULL, NULL, &size);
+    if (pid < 0)
+    {
+        perror("forkpty");
+        return 1;
+    }
+
+    if (pid == 0)
+    {
+        test_output = fdopen(output, "w");
+        setenv("TERM", term, 1);
+        unsetenv("COLORTERM");
+
+        if (!cfw_init())
+        {
+            fprintf(test_output, "CFW failed to initialize\n");
+            exit(1);
+        }
+        cfw_enable(CFW_COLORS);
+
+        test();
+
+        cfw_terminate();
+        fflush(test_output);
+        exit(test_failures > 0);
+    }
+
+    // Drain what the test draws until it exits, which closes the
+    // pseudo terminal
+    char buffer[4096];
+    while (read(terminal, buffer, sizeof(buffer)) > 0)
+        continue;
+    close(terminal);
+    close(output);
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+        return 1;
+
+    return WEXITSTATUS(status);
+}
@@ -0,0 +1,56 @@
+/**
+ * @file test.h
+ * @author Nicolai Frigaard
+ * @brief Helpers shared by the CFW tests.
+ *
+ * CFW needs a console, so every test runs in a child process with a
+ * pseudo terminal as its console. Failures are reported on the
+ * standard error of the test runner, which the console doesn't
+ * cover.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#ifndef __cfw_test_h__
+#define __cfw_test_h__
+
+#include <stdio.h>
+
+#include "internal.h"
+
+// Where failures are reported
+extern FILE *test_output;
+
+// Number of checks that failed so far
+extern int test_failures;
+
+#define TEST_CHECK(condition, ...)                                      \
+    if (!(condition))                                                   \
+    {                                                                   \
+        test_failures++;                                                \
+        fprintf(test_output, "%s:%d: ", __FILE__, __LINE__);            \
+        fprintf(test_output, __VA_ARGS__);                              \
+        fputc('\n', test_output);                                       \
+    }
+
+/**
+ * @brief Run a test with a pseudo terminal as its console.
+ *
+ * The test is called in a child process, with CFW initialized and
+ * colors enabled, and CFW is terminated after it returns.
+ *
+ * @param test The test to run.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int test_run(void (*test)(void));
+
+/**
+ * @brief Run a test with a pseudo terminal of the given type.
+ *
+ * @param test The test to run.
+ * @param term The terminal type the console claims to be.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int test_run_with_term(void (*test)(void), const char *term);
+
+#endif /* __cfw_test_h__ */
@@ -0,0 +1,52 @@
+/**
+ * @file test_ansi_draw.c
+ * @author Nicolai Frigaard
+ * @brief Tests of the escape sequences the ANSI backend writes.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "ansi_internal.h"
+
+const char *flush_frame(void)
+{
+    // Draw the frame, but keep the escape sequences from being sent
+    // so they can be looked at
+    _cfw_framebuffer_flush();
+
+    static char output[4096];
+    size_t size = min(__cfw_ansi.output_size, sizeof(output) - 1);
+    memcpy(output, __cfw_ansi.output, size);
+    output[size] = '\0';
+
+    __cfw_ansi.output_size = 0;
+    return output;
+}
+
+void test_reprint_rgb_cells(void)
+{
+    // The console has 256 colors, so the RGB color is drawn as one
+    // of them
+    TEST_CHECK(__cfw_ansi.capabilities.colors == 256,
+               "the console has %d colors", __cfw_ansi.capabilities.colors);
+
+    cfw_set_color_rgb(0x10E040, 0x202020);
+    cfw_draw_str(0, 0, "abcdefgh");
+    flush_frame();
+
+    // The two cells between the changes are cheaper to draw again
+    // than to move the cursor over
+    cfw_draw_char(0, 0, 'A');
+    cfw_draw_char(3, 0, 'D');
+    const char *output = flush_frame();
+
+    TEST_CHECK(strstr(output, "AbcD") != NULL, "the gap was skipped with \"%s\"", output);
+}
+
+int main(void)
+{
+    return test_run(test_reprint_rgb_cells);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file test_color.c
+ * @author Nicolai Frigaard
+ * @brief Tests of the color quantization.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include "test.h"
+
+void test_basic_colors_of_256(void)
+{
+    // The first 16 colors of the 256 color palette are numbered like
+    // ANSI, not like CFW
+    TEST_CHECK(_cfw_color_from_256(0) == 0x000000, "black is 0x%06x", _cfw_color_from_256(0));
+    TEST_CHECK(_cfw_color_from_256(1) == 0xCD0000, "red is 0x%06x", _cfw_color_from_256(1));
+    TEST_CHECK(_cfw_color_from_256(4) == 0x0000EE, "blue is 0x%06x", _cfw_color_from_256(4));
+    TEST_CHECK(_cfw_color_from_256(11) == 0xFFFF00, "bright yellow is 0x%06x", _cfw_color_from_256(11));
+    TEST_CHECK(_cfw_color_from_256(15) == 0xFFFFFF, "bright white is 0x%06x", _cfw_color_from_256(15));
+
+    for (int index = 0; index < 16; index++)
+    {
+        int color = (index & 10) | (index & 1) << 2 | (index & 4) >> 2;
+        TEST_CHECK(_cfw_color_from_256(index) == _cfw_color_from_16(color),
+                   "color %d is 0x%06x", index, _cfw_color_from_256(index));
+    }
+}
+
+void test_palette_round_trip(void)
+{
+    // The colors of the cube are their own closest colors. Some of the
+    // gray ramp is too close to the grays of the cube to tell apart
+    // with five bits per channel.
+    for (int index = 16; index < 232; index++)
+    {
+        int closest = _cfw_color_to_256(_cfw_color_from_256(index));
+        TEST_CHECK(_cfw_color_from_256(closest) == _cfw_color_from_256(index),
+                   "color %d is closest to %d", index, closest);
+    }
+
+    for (int color = 0; color < 16; color++)
+        TEST_CHECK(_cfw_color_to_16(_cfw_color_from_16(color)) == color,
+                   "basic color %d is closest to %d", color, _cfw_color_to_16(_cfw_color_from_16(color)));
+}
+
+int main(void)
+{
+    int result = 0;
+    result |= test_run(test_basic_colors_of_256);
+    result |= test_run(test_palette_round_trip);
+    return result;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file test_draw.c
+ * @author Nicolai Frigaard
+ * @brief Tests of the drawing functions.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include "test.h"
+
+// The last error reported by CFW
+int last_error = 0;
+
+void record_error(int error, const char *description)
+{
+    (void)description;
+    last_error = error;
+}
+
+int count_drawn_cells(void)
+{
+    __cfw_framebuffer *fb = &__cfw.framebuffer;
+
+    int count = 0;
+    for (int i = 0; i < fb->width * fb->height; i++)
+        count += (fb->back[i].glyph != ' ');
+    return count;
+}
+
+void test_negative_radius(void)
+{
+    cfw_set_error_callback(record_error);
+    cfw_clear();
+
+    last_error = 0;
+    cfw_draw_circle(10, 10, -1, '#');
+    TEST_CHECK(last_error == CFW_INVALID_VALUE, "circle radius reported 0x%x", last_error);
+
+    last_error = 0;
+    cfw_draw_ellipse(10, 10, 3, -1, '#');
+    TEST_CHECK(last_error == CFW_INVALID_VALUE, "ellipse radii reported 0x%x", last_error);
+
+    TEST_CHECK(count_drawn_cells() == 0, "%d cells drawn", count_drawn_cells());
+}
+
+int main(void)
+{
+    return test_run(test_negative_radius);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file test_format.c
+ * @author Nicolai Frigaard
+ * @brief Tests of the number drawing API.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+const char *read_row(int y, int length)
+{
+    static char text[128];
+    const __cfw_cell *row = &__cfw.framebuffer.back[y * __cfw.framebuffer.width];
+
+    // The numbers are ASCII, so every cell holds a single character
+    for (int i = 0; i < length; i++)
+        text[i] = (char)row[i].glyph;
+    text[length] = '\0';
+
+    return text;
+}
+
+void check_fixed(double value, int precision)
+{
+    char expected[64];
+    int length = snprintf(expected, sizeof(expected), "%.*f", precision, value);
+
+    cfw_clear();
+    cfw_draw_fixed(0, 0, value, 0, precision, 0);
+
+    const char *drawn = read_row(0, length);
+    TEST_CHECK(strcmp(drawn, expected) == 0, "%.17g with %d decimals drawn as %s, not %s",
+               value, precision, drawn, expected);
+}
+
+void test_fixed_ties(void)
+{
+    // Ties of the exact binary value are rounded to even
+    check_fixed(0.125, 2);
+    check_fixed(0.375, 2);
+    check_fixed(2.5, 0);
+    check_fixed(3.5, 0);
+    check_fixed(0.5, 0);
+    check_fixed(-2.5, 0);
+    check_fixed(1.0625, 3);
+
+    // Decimal ties that aren't ties in binary round the way their
+    // exact value lies
+    check_fixed(2.675, 2);
+    check_fixed(1.005, 2);
+    check_fixed(0.045, 2);
+    check_fixed(1.45, 1);
+}
+
+void test_fixed_matches_printf(void)
+{
+    uint64_t state = 0x9E3779B97F4A7C15u;
+
+    for (int i = 0; i < 20000; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        // Values with few bits land on decimal ties more often. They
+        // are kept small enough to be rounded without the exponent.
+        double value = (double)(state >> 44) / (double)(1u << (state & 15));
+        int precision = (int)((state >> 4) % 10);
+
+        check_fixed(value, precision);
+        check_fixed(value / 1000.0, precision);
+    }
+}
+
+int main(void)
+{
+    int result = 0;
+    result |= test_run(test_fixed_ties);
+    result |= test_run(test_fixed_matches_printf);
+    return result;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file test_intern.c
+ * @author Nicolai Frigaard
+ * @brief Tests of the interned styles and graphemes.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#include <string.h>
+
+#include "test.h"
+
+void fill_grapheme_table(void)
+{
+    __cfw_intern *table = &__cfw.grapheme_table;
+
+    // Intern graphemes no cell references until the table is full, so
+    // the next grapheme collects the tables
+    for (int mark = 0x300; mark < 0x370; mark++)
+    {
+        if (table->capacity > 0 && table->count == table->capacity && table->free < 0)
+            return;
+
+        char text[3] = { 'a', (char)(0xC0 | (mark >> 6)), (char)(0x80 | (mark & 0x3F)) };
+        _cfw_intern_grapheme(text, sizeof(text));
+    }
+}
+
+uint32_t get_cell_fg(int x, int y)
+{
+    const __cfw_cell *cell = &__cfw.framebuffer.back[y * __cfw.framebuffer.width + x];
+    return __cfw.styles[cell->style].fg;
+}
+
+void test_run_collected_by_grapheme(void)
+{
+    cfw_clear();
+    fill_grapheme_table();
+
+    // The grapheme the run starts with collects the tables before any
+    // cell is drawn with its style
+    cfw__attr_run run = { 4, 0x123456, CFW_CURRENT_COLOR, CFW_ATTR_RGB };
+    cfw_draw_attr_str(0, 0, "b\xCC\x81x", &run, 1);
+
+    // A style interned after the run must not take its id
+    cfw_set_color_rgb(0x654321, 0x000000);
+
+    TEST_CHECK(get_cell_fg(0, 0) == (_CFW_COLOR_RGB | 0x123456),
+               "grapheme drawn with fg 0x%x", get_cell_fg(0, 0));
+    TEST_CHECK(get_cell_fg(1, 0) == (_CFW_COLOR_RGB | 0x123456),
+               "run drawn with fg 0x%x", get_cell_fg(1, 0));
+}
+
+void test_clipped_run_collected_by_grapheme(void)
+{
+    cfw_clear();
+    fill_grapheme_table();
+
+    // The first run is clipped, so only the second one references
+    // their shared style
+    cfw__attr_run runs[2] =
+    {
+        { 5, 0xABCDEF, CFW_CURRENT_COLOR, CFW_ATTR_RGB },
+        { 1, 0xABCDEF, CFW_CURRENT_COLOR, CFW_ATTR_RGB }
+    };
+    cfw_draw_attr_str(-3, 0, "zzb\xCC\x81q", runs, 2);
+
+    cfw_set_color_rgb(0x654321, 0x000000);
+
+    TEST_CHECK(get_cell_fg(0, 0) == (_CFW_COLOR_RGB | 0xABCDEF),
+               "second run drawn with fg 0x%x", get_cell_fg(0, 0));
+}
+
+int main(void)
+{
+    int result = 0;
+    result |= test_run(test_run_collected_by_grapheme);
+    result |= test_run(test_clipped_run_collected_by_grapheme);
+    return result;
+}
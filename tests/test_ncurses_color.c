@@ -0,0 +1,129 @@
+/**
+ * @file test_ncurses_color.c
+ * @author Nicolai Frigaard
+ * @brief Tests of the ncurses color pair cache.
+ *
+ * @copyright Copyright (c) 2020
+ */
+
+#define _XOPEN_SOURCE 700
+#define NCURSES_WIDECHAR 1
+
+#include <ncurses.h>
+
+#include "test.h"
+
+int get_frame_color(int frame, int x, int y, int channel)
+{
+    // Every cell of every frame gets its own pair of colors from the
+    // 6x6x6 color cube
+    int index = frame * __cfw.framebuffer.width * __cfw.framebuffer.height +
+                y * __cfw.framebuffer.width + x;
+    int color = 16 + (index / (channel ? 216 : 1)) % 216;
+
+    // The color the console draws it as
+    return _cfw_color_to_256(_cfw_color_from_256(color));
+}
+
+void get_cell_colors(int x, int y, short *fg, short *bg)
+{
+    // Pair numbers above 255 only fit in the wide characters
+    cchar_t cell;
+    wchar_t text[CCHARW_MAX];
+    attr_t attributes;
+    short pair;
+
+    mvin_wch(y, x, &cell);
+    getcchar(&cell, text, &attributes, &pair, NULL);
+    pair_content(pair, fg, bg);
+}
+
+short get_basic_color(int color)
+{
+    // Curses numbers the colors like ANSI, which swaps red and blue
+    return (short)((color & 2) | (color & 1) << 2 | (color & 4) >> 2);
+}
+
+void test_pairs_redefined_off_screen(void)
+{
+    int width = __cfw.framebuffer.width;
+    int height = __cfw.framebuffer.height;
+
+    // Draw more pairs of colors than the console has pairs
+    int frames = COLOR_PAIRS / (width * height) + 2;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                cfw_set_color_rgb(_cfw_color_from_256(get_frame_color(frame, x, y, 0)),
+                                  _cfw_color_from_256(get_frame_color(frame, x, y, 1)));
+                cfw_draw_char(x, y, '#');
+            }
+        }
+        cfw_refresh();
+    }
+
+    // Every cell on the screen still has the colors it was drawn with
+    int wrong = 0;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            short fg, bg;
+            get_cell_colors(x, y, &fg, &bg);
+
+            if (fg != get_frame_color(frames - 1, x, y, 0) ||
+                bg != get_frame_color(frames - 1, x, y, 1))
+                wrong++;
+        }
+    }
+    TEST_CHECK(wrong == 0, "%d cells drawn with the wrong colors", wrong);
+}
+
+void test_closest_pair_replaced(void)
+{
+    // Every pair of the 8 colors takes one more pair than the console
+    // has, so the last one is drawn with the closest pair
+    TEST_CHECK(COLOR_PAIRS == 64, "the console has %d pairs", COLOR_PAIRS);
+
+    for (int i = 0; i < 64; i++)
+    {
+        cfw_set_color(i & 7, i >> 3);
+        cfw_draw_char(i, 0, '#');
+    }
+    cfw_refresh();
+
+    short fg, bg;
+    get_cell_colors(63, 0, &fg, &bg);
+    TEST_CHECK(fg != get_basic_color(7) || bg != get_basic_color(7),
+               "the last cell got its own pair while every pair was on the screen");
+
+    // Drawing over the only cell of a pair frees it for the last cell
+    cfw_set_default_color();
+    cfw_draw_char(0, 0, ' ');
+    cfw_refresh();
+
+    get_cell_colors(63, 0, &fg, &bg);
+    TEST_CHECK(fg == get_basic_color(7) && bg == get_basic_color(7),
+               "the last cell is drawn with %d on %d", fg, bg);
+
+    // The other cells kept their colors
+    for (int i = 1; i < 63; i++)
+    {
+        get_cell_colors(i, 0, &fg, &bg);
+        TEST_CHECK(fg == get_basic_color(i & 7) && bg == get_basic_color(i >> 3),
+                   "cell %d is drawn with %d on %d", i, fg, bg);
+    }
+}
+
+int main(void)
+{
+    int result = 0;
+    result |= test_run(test_pairs_redefined_off_screen);
+
+    // The basic xterm only has 8 colors and 64 pairs
+    result |= test_run_with_term(test_closest_pair_replaced, "xterm");
+    return result;
+}
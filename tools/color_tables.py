@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Generates src/color_tables.h, the closest palette colors.
+
+Consoles that can't display 24-bit colors get the closest color of
+their palette instead. The tables are indexed by the five most
+significant bits of each channel, and hold the closest color of the
+xterm 256 color palette, and of the 16 and 8 basic colors.
+
+Usage: python3 tools/color_tables.py > src/color_tables.h
+"""
+
+LEVELS = 32
+
+# The default xterm palette of the 16 basic colors, in CFW order
+BASIC_PALETTE = [
+    (0, 0, 0), (0, 0, 238), (0, 205, 0), (0, 205, 205),
+    (205, 0, 0), (205, 0, 205), (205, 205, 0), (229, 229, 229),
+    (127, 127, 127), (92, 92, 255), (0, 255, 0), (0, 255, 255),
+    (255, 0, 0), (255, 0, 255), (255, 255, 0), (255, 255, 255),
+]
+
+CUBE_LEVELS = (0, 95, 135, 175, 215, 255)
+
+
+def color_256(index):
+    if index < 232:
+        index -= 16
+        return (CUBE_LEVELS[index // 36], CUBE_LEVELS[index // 6 % 6], CUBE_LEVELS[index % 6])
+
+    gray = 8 + (index - 232) * 10
+    return (gray, gray, gray)
+
+
+def distance(a, b):
+    # Green is weighted the most, as the eye is most sensitive to it
+    r, g, b = a[0] - b[0], a[1] - b[1], a[2] - b[2]
+    return 2 * r * r + 4 * g * g + 3 * b * b
+
+
+def closest(color, palette):
+    # The first of the closest colors wins
+    return min(range(len(palette)), key=lambda i: distance(color, palette[i]))
+
+
+def main():
+    # The first 16 colors of the 256 color palette are often changed
+    # by color themes, so only the cube and the gray ramp are used
+    palette_256 = [color_256(index) for index in range(16, 256)]
+
+    table_256 = []
+    table_16 = []
+    for i in range(LEVELS ** 3):
+        # Use the center of the range of colors sharing the entry
+        color = ((i >> 10) << 3 | 4, (i >> 5 & 31) << 3 | 4, (i & 31) << 3 | 4)
+
+        table_256.append(16 + closest(color, palette_256))
+        table_16.append(closest(color, BASIC_PALETTE) | closest(color, BASIC_PALETTE[:8]) << 4)
+
+    print('// Generated by tools/color_tables.py. Do not edit.')
+    print()
+    print('#define COLOR_TABLE_SIZE %d' % (LEVELS ** 3))
+    for name, comment, table in (
+            ('color_table_256', 'Closest color in the xterm 256 color palette', table_256),
+            ('color_table_16', 'Closest of the 16 basic colors in the low nibble, and of the 8\n'
+                               '// normal ones in the high nibble', table_16)):
+        print()
+        print('// ' + comment)
+        print('static const unsigned char %s[COLOR_TABLE_SIZE] =' % name)
+        print('{')
+        for i in range(0, len(table), 16):
+            print('    ' + ', '.join('%3d' % v for v in table[i:i + 16]) + ',')
+        print('};')
+
+
+if __name__ == '__main__':
+    main()
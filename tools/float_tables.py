@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+"""Generates src/float_tables.h, the powers of 5 used to format floats.
+
+Floats are formatted with the Ryu algorithm by Ulf Adams, which
+multiplies the binary mantissa by a fixed-point power of 5 or its
+inverse. Each power is scaled so it has the given number of bits.
+
+Usage: python3 tools/float_tables.py > src/float_tables.h
+"""
+
+POW5_INV_BITCOUNT = 59
+POW5_BITCOUNT = 61
+
+# Largest powers needed for the exponents of 32-bit floats
+POW5_INV_COUNT = 31
+POW5_COUNT = 48
+
+
+def main():
+    inverse = []
+    for i in range(POW5_INV_COUNT):
+        pow5 = 5 ** i
+        shift = pow5.bit_length() - 1 + POW5_INV_BITCOUNT
+        inverse.append((1 << shift) // pow5 + 1)
+
+    powers = []
+    for i in range(POW5_COUNT):
+        pow5 = 5 ** i
+        shift = pow5.bit_length() - POW5_BITCOUNT
+        powers.append(pow5 >> shift if shift >= 0 else pow5 << -shift)
+
+    print('// Generated by tools/float_tables.py. Do not edit.')
+    print()
+    print('#define FLOAT_POW5_INV_BITCOUNT %d' % POW5_INV_BITCOUNT)
+    print('#define FLOAT_POW5_BITCOUNT %d' % POW5_BITCOUNT)
+    print()
+    for name, table in (('float_pow5_inv_split', inverse), ('float_pow5_split', powers)):
+        print('static const uint64_t %s[%d] =' % (name, len(table)))
+        print('{')
+        for i in range(0, len(table), 3):
+            print('    ' + ', '.join('0x%016xu' % v for v in table[i:i + 3]) + ',')
+        print('};')
+        print()
+
+
+if __name__ == '__main__':
+    main()
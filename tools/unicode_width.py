@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Generates src/unicode_width.h, the table of display widths.
+
+The width of every codepoint is stored in two bits, in blocks of 256
+codepoints. Identical blocks are only stored once, and the first stage
+of the table maps the upper bits of a codepoint to its block.
+
+Usage: python3 tools/unicode_width.py > src/unicode_width.h
+"""
+
+import unicodedata
+
+BLOCK_SIZE = 256
+CODEPOINTS = 0x110000
+
+
+def width(codepoint):
+    char = chr(codepoint)
+    category = unicodedata.category(char)
+
+    # Control characters aren't drawn, and combining marks and format
+    # characters take no space of their own. The soft hyphen is drawn
+    # as a hyphen by most consoles.
+    if category in ('Cc', 'Mn', 'Me') or codepoint == 0:
+        return 0
+    if category == 'Cf' and codepoint != 0x00AD:
+        return 0
+
+    # Hangul Jamo medial vowels and final consonants combine with the
+    # preceding initial consonant
+    if 0x1160 <= codepoint <= 0x11FF or 0xD7B0 <= codepoint <= 0xD7FF:
+        return 0
+
+    if unicodedata.east_asian_width(char) in ('W', 'F'):
+        return 2
+
+    return 1
+
+
+def main():
+    blocks = []
+    block_ids = {}
+    stage1 = []
+
+    for start in range(0, CODEPOINTS, BLOCK_SIZE):
+        packed = bytearray(BLOCK_SIZE // 4)
+        for offset in range(BLOCK_SIZE):
+            packed[offset >> 2] |= width(start + offset) << ((offset & 3) * 2)
+
+        packed = bytes(packed)
+        if packed not in block_ids:
+            block_ids[packed] = len(blocks)
+            blocks.append(packed)
+        stage1.append(block_ids[packed])
+
+    assert len(blocks) <= 256
+
+    print('// Generated by tools/unicode_width.py from Unicode %s. Do not edit.'
+          % unicodedata.unidata_version)
+    print()
+    print('#define UNICODE_WIDTH_BLOCK_SIZE %d' % BLOCK_SIZE)
+    print()
+    print('static const unsigned char width_stage1[%d] =' % len(stage1))
+    print('{')
+    for i in range(0, len(stage1), 16):
+        print('    ' + ', '.join('%3d' % b for b in stage1[i:i + 16]) + ',')
+    print('};')
+    print()
+    print('static const unsigned char width_stage2[%d][%d] =' % (len(blocks), BLOCK_SIZE // 4))
+    print('{')
+    for block in blocks:
+        print('    {')
+        for i in range(0, len(block), 16):
+            print('        ' + ', '.join('0x%02x' % b for b in block[i:i + 16]) + ',')
+        print('    },')
+    print('};')
+
+
+if __name__ == '__main__':
+    main()